@@ -0,0 +1,259 @@
+#include "Apa102Spi.h"
+#include <esp_heap_caps.h>
+
+#define APA102_START_FRAME_BYTES 4
+#define APA102_LED_BYTES 4
+
+/**
+ * Sets up the SPI host, the DMA buffers and the device.
+ *
+ * @param spiHost The SPI host to use (HSPI_HOST or VSPI_HOST).
+ * @param dataPin APA102 data (MOSI), routed through the GPIO matrix.
+ * @param clockPin APA102 clock (SCLK), routed through the GPIO matrix.
+ * @param ledCount Number of LEDs on the strip.
+ * @param clockHz SPI clock rate.
+ * @return true if the driver is ready.
+ */
+bool Apa102Spi::begin(spi_host_device_t spiHost, int dataPin, int clockPin, uint16_t ledCount, uint32_t clockHz)
+{
+    // Whatever an earlier begin() on this object left behind
+    release();
+
+    host = spiHost;
+    numLeds = ledCount;
+
+    // The end frame needs at least one clock edge per two LEDs for the data to
+    // propagate down the strip. Pad generously; extra ones are harmless.
+    size_t endFrameBytes = 4 + (numLeds + 15) / 16;
+    bufferLength = APA102_START_FRAME_BYTES + numLeds * APA102_LED_BYTES + endFrameBytes;
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        dmaBuffers[i] = (uint8_t *)heap_caps_malloc(bufferLength, MALLOC_CAP_DMA);
+        if (!dmaBuffers[i])
+        {
+            Serial.println("Apa102Spi: failed to allocate DMA buffer");
+            release();
+            return false;
+        }
+        memset(dmaBuffers[i], 0x00, APA102_START_FRAME_BYTES);
+        memset(dmaBuffers[i] + bufferLength - endFrameBytes, 0xFF, endFrameBytes);
+    }
+
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = dataPin;
+    bus.miso_io_num = -1;
+    bus.sclk_io_num = clockPin;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = bufferLength;
+
+    esp_err_t err = spi_bus_initialize(host, &bus, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK)
+    {
+        Serial.printf("Apa102Spi: bus init failed: %s\n", esp_err_to_name(err));
+        release();
+        return false;
+    }
+    busReady = true;
+
+    spi_device_interface_config_t dev = {};
+    dev.mode = 0;
+    dev.clock_speed_hz = clockHz;
+    clockRate = clockHz;
+    dev.spics_io_num = -1; // APA102 has no chip select
+    dev.flags = SPI_DEVICE_HALFDUPLEX;
+    dev.queue_size = 1;
+    dev.post_cb = &Apa102Spi::postTransfer;
+
+    err = spi_bus_add_device(host, &dev, &device);
+    if (err != ESP_OK)
+    {
+        Serial.printf("Apa102Spi: add device failed: %s\n", esp_err_to_name(err));
+        device = NULL;
+        release();
+        return false;
+    }
+
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.user = this;
+
+    Serial.printf("Apa102Spi: %u LEDs at %u kHz, %u byte frames\n", numLeds, clockHz / 1000, bufferLength);
+    return true;
+}
+
+/**
+ * Frees everything begin() set up, so a failed begin() doesn't leave the
+ * DMA buffers or the SPI host tied up.
+ */
+void Apa102Spi::release(void)
+{
+    if (device)
+    {
+        spi_bus_remove_device(device);
+        device = NULL;
+    }
+    if (busReady)
+    {
+        spi_bus_free(host);
+        busReady = false;
+    }
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        heap_caps_free(dmaBuffers[i]);
+        dmaBuffers[i] = NULL;
+    }
+    bufferLength = 0;
+}
+
+void Apa102Spi::setCompletionCallback(CompletionCallback callback, void *arg)
+{
+    onCompleteArg = arg;
+    onComplete = callback;
+}
+
+void IRAM_ATTR Apa102Spi::postTransfer(spi_transaction_t *trans)
+{
+    Apa102Spi *driver = (Apa102Spi *)trans->user;
+    driver->busy = false;
+    driver->completed++;
+    if (driver->onComplete)
+    {
+        driver->onComplete(driver->onCompleteArg);
+    }
+}
+
+/**
+ * Collects the result of the queued transaction so the driver can take the
+ * next one.
+ */
+void Apa102Spi::collect(TickType_t timeout)
+{
+    if (!inFlight)
+    {
+        return;
+    }
+    spi_transaction_t *result;
+    if (spi_device_get_trans_result(device, &result, timeout) == ESP_OK)
+    {
+        inFlight = false;
+    }
+}
+
+/**
+ * Encodes a frame and queues it for transfer.
+ *
+ * @param pixels numLeds pixels in RGB order.
+ * @param brightness Scale applied to every channel. 0 pushes an all-black frame.
+ * @return true if the frame was queued.
+ */
+bool Apa102Spi::show(const CRGB *pixels, uint8_t brightness)
+{
+    if (!device)
+    {
+        return false;
+    }
+
+    // Encode into the buffer that isn't on the wire
+    uint8_t *out = dmaBuffers[nextBuffer] + APA102_START_FRAME_BYTES;
+    if (!color.isActive())
+    {
+        for (uint16_t i = 0; i < numLeds; i++)
+        {
+            const CRGB &pixel = pixels[i];
+            *out++ = 0xE0 | 31; // Full 5-bit global brightness, scaling is done on the channels
+            *out++ = scale8(pixel.b, brightness);
+            *out++ = scale8(pixel.g, brightness);
+            *out++ = scale8(pixel.r, brightness);
+        }
+    }
+    else
+    {
+        color.prepare(brightness);
+        if (color.isDithering())
+        {
+            encodeCorrected<true>(pixels, out);
+        }
+        else
+        {
+            encodeCorrected<false>(pixels, out);
+        }
+    }
+
+    // Only one transfer is queued at a time; this normally returns at once
+    // because the last frame finished long ago.
+    collect(portMAX_DELAY);
+
+    transaction.length = bufferLength * 8;
+    transaction.tx_buffer = dmaBuffers[nextBuffer];
+    busy = true;
+    if (spi_device_queue_trans(device, &transaction, portMAX_DELAY) != ESP_OK)
+    {
+        busy = false;
+        return false;
+    }
+    inFlight = true;
+    nextBuffer ^= 1;
+    return true;
+}
+
+/**
+ * Waits for the most recently queued frame to finish.
+ *
+ * @return true if nothing is left on the wire.
+ */
+bool Apa102Spi::waitDone(TickType_t timeout)
+{
+    collect(timeout);
+    return !inFlight;
+}
+
+bool Apa102Spi::isBusy(void)
+{
+    return busy;
+}
+
+uint32_t Apa102Spi::getCompleted(void)
+{
+    return completed;
+}
+
+/**
+ * Encodes through the color stage. Brightness is already in its tables.
+ */
+template <bool Dither>
+void Apa102Spi::encodeCorrected(const CRGB *pixels, uint8_t *out)
+{
+    for (uint16_t i = 0; i < numLeds; i++)
+    {
+        uint8_t r, g, b;
+        color.apply<Dither>(pixels[i], i, r, g, b);
+        *out++ = 0xE0 | 31;
+        *out++ = b;
+        *out++ = g;
+        *out++ = r;
+    }
+}
+
+/**
+ * Sets this strip's output color stage. Call before the first show().
+ */
+void Apa102Spi::setColorSettings(const ColorSettings &settings)
+{
+    color.configure(settings);
+}
+
+const ColorStage &Apa102Spi::getColorStage(void)
+{
+    return color;
+}
+
+size_t Apa102Spi::getBufferLength(void)
+{
+    return bufferLength;
+}
+
+uint32_t Apa102Spi::getWireUs(void)
+{
+    return clockRate ? (uint32_t)((uint64_t)bufferLength * 8 * 1000000 / clockRate) : 0;
+}
@@ -0,0 +1,67 @@
+#ifndef APA102SPI_H
+#define APA102SPI_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <driver/spi_master.h>
+#include "ColorStage.h"
+
+/*
+    APA102 output through an ESP32 SPI host with DMA.
+
+    show() encodes the pixels into a DMA buffer, queues the transfer and
+    returns. The SPI peripheral clocks the frame out on its own, so the caller
+    is free as soon as the encode is done. Two DMA buffers are used so the
+    next frame can be encoded while the previous one is still on the wire.
+
+    Completion is signalled from the SPI driver's post-transfer callback:
+    isBusy() goes false, the completed count increments and the optional
+    completion callback runs (in ISR context).
+*/
+class Apa102Spi
+{
+public:
+    typedef void (*CompletionCallback)(void *arg); // Runs in ISR context
+
+private:
+    spi_host_device_t host;
+    spi_device_handle_t device = NULL;
+    bool busReady = false; // spi_bus_initialize() succeeded on host
+    uint8_t *dmaBuffers[2] = {NULL, NULL};
+    uint8_t nextBuffer = 0;
+    size_t bufferLength = 0;
+    uint16_t numLeds = 0;
+    uint32_t clockRate = 0;
+    ColorStage color;
+    spi_transaction_t transaction;
+    bool inFlight = false; // A queued transaction whose result hasn't been collected
+
+    volatile bool busy = false;
+    volatile uint32_t completed = 0;
+    CompletionCallback onComplete = NULL;
+    void *onCompleteArg = NULL;
+
+    static void IRAM_ATTR postTransfer(spi_transaction_t *trans);
+    void collect(TickType_t timeout);
+    void release(void);
+
+    template <bool Dither>
+    void encodeCorrected(const CRGB *pixels, uint8_t *out);
+
+public:
+    bool begin(spi_host_device_t spiHost, int dataPin, int clockPin, uint16_t ledCount, uint32_t clockHz);
+    void setCompletionCallback(CompletionCallback callback, void *arg);
+    void setColorSettings(const ColorSettings &settings); // Gamma, correction and dithering for this strip
+    const ColorStage &getColorStage(void);
+
+    bool show(const CRGB *pixels, uint8_t brightness); // Encode and queue. Returns without waiting for the transfer.
+    bool waitDone(TickType_t timeout);                 // Block until the last queued frame is out
+    bool isBusy(void);
+    uint32_t getCompleted(void);
+    size_t getBufferLength(void); // Bytes in one DMA buffer
+    uint32_t getWireUs(void);     // Time one frame spends on the wire
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "ColorStage.h"
+
+void ColorStage::configure(const ColorSettings &colorSettings)
+{
+    settings = colorSettings;
+    if (settings.gamma <= 0.0f)
+    {
+        settings.gamma = 1.0f;
+    }
+
+    // The only place floating point is used
+    for (uint16_t v = 0; v < 256; v++)
+    {
+        curve[v] = settings.gamma == 1.0f ? v * 257 : (uint16_t)(powf(v / 255.0f, settings.gamma) * 65535.0f + 0.5f);
+    }
+    valid = false;
+}
+
+/**
+ * Gets the tables and dither offset ready for the next frame.
+ *
+ * @param brightness Applied in the tables. Only a change of brightness rebuilds them.
+ */
+void ColorStage::prepare(uint8_t brightness)
+{
+    if (!valid || brightness != tableBrightness)
+    {
+        buildTables(brightness);
+    }
+
+    if (!settings.dither)
+    {
+        return;
+    }
+
+    uint32_t now = micros();
+    uint32_t interval = now - lastPrepareUs;
+    lastPrepareUs = now;
+    // Ignore gaps, eg: while frames were skipped
+    if (interval < 1000000)
+    {
+        frameUs = frameUs ? (frameUs * 7 + interval) / 8 : interval;
+    }
+
+    // The longest cycle that still repeats at DITHER_MIN_HZ
+    uint32_t frameRate = frameUs ? 1000000 / frameUs : 0;
+    ditherBits = 0;
+    while (ditherBits < DITHER_MAX_BITS && frameRate >= ((uint32_t)DITHER_MIN_HZ << (ditherBits + 1)))
+    {
+        ditherBits++;
+    }
+
+    // Bit-reversed frame count, so consecutive frames are spread out over the cycle
+    ditherFrame++;
+    uint8_t reversed = 0;
+    for (uint8_t i = 0; i < ditherBits; i++)
+    {
+        reversed |= ((ditherFrame >> i) & 1) << (ditherBits - 1 - i);
+    }
+    ditherBase = reversed;
+}
+
+/**
+ * Scales the gamma curve by each channel's correction and the brightness.
+ */
+void ColorStage::buildTables(uint8_t brightness)
+{
+    const uint8_t scale[3] = {
+        (uint8_t)(settings.correction >> 16),
+        (uint8_t)(settings.correction >> 8),
+        (uint8_t)settings.correction,
+    };
+
+    for (uint8_t c = 0; c < 3; c++)
+    {
+        // 8.8 fixed point, 255.0 at full scale: 65535 * 255 * 255 / 65280.
+        // The largest product still fits in 32 bits.
+        uint32_t factor = (uint32_t)scale[c] * brightness;
+        for (uint16_t v = 0; v < 256; v++)
+        {
+            tables[c][v] = ((uint32_t)curve[v] * factor + 32640) / 65280;
+        }
+    }
+    tableBrightness = brightness;
+    valid = true;
+}
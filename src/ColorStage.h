@@ -0,0 +1,89 @@
+#ifndef COLORSTAGE_H
+#define COLORSTAGE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#define DITHER_MIN_HZ 25 // Slowest a full dither cycle may repeat, so it doesn't flicker
+#define DITHER_MAX_BITS 4
+
+/*
+    Per-strip output color settings, from the "strips" section of the config
+    file. The defaults leave pixels exactly as rendered.
+*/
+struct ColorSettings
+{
+    float gamma = 1.0f;             // 1.0 is linear. The bundled gradient palettes are already gamma corrected.
+    uint32_t correction = 0xFFFFFF; // Per-channel scale as 0xRRGGBB, eg: FastLED's TypicalLEDStrip is 0xFFB0F0
+    bool dither = false;            // Temporal dithering of the fraction the 8-bit output loses
+
+    bool isIdentity(void) const
+    {
+        return gamma == 1.0f && correction == 0xFFFFFF && !dither;
+    }
+};
+
+/*
+    Final output stage for one strip: gamma, color correction, brightness and
+    temporal dithering, all from lookup tables.
+
+    Each channel has a 256-entry table of 8.8 fixed-point output levels, so a
+    pixel costs three table reads. The gamma curve is worked out once when
+    the settings change; a brightness change, which the power limiter can
+    make every frame, only rescales it with integer math.
+    With dithering, a per-frame offset is added below the 8-bit output so the
+    lost fraction is spread over successive frames. The cycle is sized from
+    the measured push rate: it uses as many bits as can repeat at
+    DITHER_MIN_HZ or faster.
+*/
+class ColorStage
+{
+private:
+    ColorSettings settings;
+    uint16_t curve[256];     // Gamma curve, 0 to 65535
+    uint16_t tables[3][256]; // r, g, b
+    uint8_t tableBrightness = 0;
+    bool valid = false;
+
+    uint32_t lastPrepareUs = 0;
+    uint32_t frameUs = 0;   // Smoothed interval between frames
+    uint8_t ditherBits = 0; // Fraction bits dithered this frame
+    uint8_t ditherFrame = 0;
+    uint8_t ditherBase = 0; // Frame part of the dither offset
+
+    void buildTables(uint8_t brightness);
+
+public:
+    void configure(const ColorSettings &colorSettings);
+    const ColorSettings &getSettings(void) const { return settings; }
+    bool isActive(void) const { return !settings.isIdentity(); }
+    bool isDithering(void) const { return settings.dither; }
+
+    void prepare(uint8_t brightness); // Once per frame, before apply()
+    uint8_t getDitherBits(void) const { return ditherBits; }
+
+    // pixel only varies the dither pattern across the strip
+    template <bool Dither>
+    inline void apply(const CRGB &in, uint16_t pixel, uint8_t &r, uint8_t &g, uint8_t &b) const
+    {
+        if (Dither)
+        {
+            uint8_t mask = (1 << ditherBits) - 1;
+            uint16_t offset = (uint16_t)((ditherBase + pixel) & mask) << (8 - ditherBits);
+            r = min((tables[0][in.r] + offset) >> 8, 255);
+            g = min((tables[1][in.g] + offset) >> 8, 255);
+            b = min((tables[2][in.b] + offset) >> 8, 255);
+        }
+        else
+        {
+            // Round to nearest rather than truncating
+            r = min((tables[0][in.r] + 128) >> 8, 255);
+            g = min((tables[1][in.g] + 128) >> 8, 255);
+            b = min((tables[2][in.b] + 128) >> 8, 255);
+        }
+    }
+};
+
+#endif
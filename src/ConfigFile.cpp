@@ -0,0 +1,473 @@
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "ConfigFile.h"
+#include "LightUtils.h"
+#include "utilities/PreferencesManager.h"
+
+BootConfig bootConfig;
+
+/**
+ * Overlays the "lighting" section on the current light configuration. The
+ * result is only applied (and saved) if something actually changed.
+ */
+static void applyLightingSection(JsonObjectConst section)
+{
+    LightConfig current = lightUtils->getConfig();
+    LightConfig config = current;
+
+    config.brightness = section["brightness"] | config.brightness;
+    config.program = section["program"] | config.program;
+    config.sin = section["sin"] | config.sin;
+    config.updates = section["updates"] | config.updates;
+    config.reverse = section["reverse"] | config.reverse;
+    config.fire = section["fire"] | config.fire;
+    config.localDisable = section["local_disable"] | config.localDisable;
+    config.autoLight = section["auto"] | config.autoLight;
+    config.autoTime = section["auto_time"] | config.autoTime;
+    config.reverseSecondRow = section["reverse_second_row"] | config.reverseSecondRow;
+    config.circularMode = section["circular_mode"] | config.circularMode;
+    config.blendTime = section["blend_time"] | config.blendTime;
+    config.circularArms = section["circular_arms"] | config.circularArms;
+    config.circularSpin = section["circular_spin"] | config.circularSpin;
+    config.fadeTime = section["fade_time"] | config.fadeTime;
+    config.fadeCurve = section["fade_curve"] | config.fadeCurve;
+    config.fireCooling = section["fire_cooling"] | config.fireCooling;
+    config.fireSparking = section["fire_sparking"] | config.fireSparking;
+    config.fireColumns = section["fire_columns"] | config.fireColumns;
+    config.particleCap = section["particle_cap"] | config.particleCap;
+    const char *effect = section["effect"];
+    if (effect && (!effect[0] || EffectRegistry::find(effect)))
+    {
+        strlcpy(config.effect, effect, sizeof(config.effect));
+    }
+    const char *text = section["text"];
+    if (text)
+    {
+        strlcpy(config.text, text, sizeof(config.text));
+    }
+
+    // Same limits as the web UI
+    sanitizeConfig(config);
+
+    if (memcmp(&config, &current, sizeof(config)) != 0)
+    {
+        lightUtils->applyConfig(config);
+        Serial.println("Config file: lighting applied");
+    }
+}
+
+/**
+ * Replaces the strip layout. Strips are listed in slot order; slots left out
+ * aren't fitted.
+ */
+static void applyStripsSection(JsonArrayConst section)
+{
+    StripLayout layout;
+    uint16_t total = 0;
+    uint8_t slot = 0;
+
+    for (JsonObjectConst entry : section)
+    {
+        if (slot == MAX_STRIPS)
+        {
+            Serial.println("Config file: too many strips, ignoring the rest");
+            break;
+        }
+        uint16_t leds = entry["leds"] | 0;
+        leds = min(leds, (uint16_t)(MAX_LEDS - total));
+
+        ColorSettings &color = layout.color[slot];
+        color.gamma = entry["gamma"] | color.gamma;
+        color.dither = entry["dither"] | color.dither;
+        layout.maxMilliamps[slot] = entry["max_ma"] | layout.maxMilliamps[slot];
+        const char *correction = entry["correction"];
+        if (correction)
+        {
+            color.correction = strtoul(correction + (correction[0] == '#'), NULL, 16) & 0xFFFFFF;
+        }
+
+        layout.leds[slot++] = leds;
+        total += leds;
+    }
+    while (slot < MAX_STRIPS)
+    {
+        layout.leds[slot++] = 0;
+    }
+
+    if (total == 0)
+    {
+        Serial.println("Config file: no LEDs in the strip layout, keeping the defaults");
+        return;
+    }
+    bootConfig.strips = layout;
+}
+
+/**
+ * Replaces the segment pool with the segments in the file. Nothing is
+ * written unless the list differs from the stored one.
+ */
+static void applySegmentsSection(JsonArrayConst section)
+{
+    SegmentConfig wanted[MAX_SEGMENTS];
+    uint8_t count = 0;
+
+    for (JsonObjectConst entry : section)
+    {
+        if (count == MAX_SEGMENTS)
+        {
+            Serial.println("Config file: too many segments, ignoring the rest");
+            break;
+        }
+        SegmentConfig &segment = wanted[count++];
+        strlcpy(segment.name, entry["name"] | "", sizeof(segment.name));
+        segment.start = entry["start"] | segment.start;
+        segment.length = entry["length"] | segment.length;
+        segment.program = entry["program"] | segment.program;
+        segment.speed = entry["speed"] | segment.speed;
+        segment.sin = min((uint8_t)(entry["sin"] | segment.sin), (uint8_t)32);
+        segment.reverse = entry["reverse"] | segment.reverse;
+        segment.fire = entry["fire"] | segment.fire;
+        segment.cooling = entry["cooling"] | segment.cooling;
+        segment.sparking = entry["sparking"] | segment.sparking;
+        segment.columns = max((uint8_t)(entry["columns"] | segment.columns), (uint8_t)1);
+        const char *effect = entry["effect"];
+        if (effect && (!effect[0] || EffectRegistry::find(effect)))
+        {
+            strlcpy(segment.effect, effect, sizeof(segment.effect));
+        }
+    }
+
+    SegmentPool &pool = lightUtils->getSegments();
+    SegmentConfig current[MAX_SEGMENTS];
+    uint8_t currentCount = pool.list(current);
+
+    bool same = currentCount == count;
+    for (uint8_t i = 0; same && i < count; i++)
+    {
+        // Stored segments are sorted by start, so compare by name
+        same = false;
+        for (uint8_t j = 0; j < currentCount; j++)
+        {
+            if (strcmp(current[j].name, wanted[i].name) == 0)
+            {
+                const SegmentConfig &a = current[j];
+                const SegmentConfig &b = wanted[i];
+                same = a.start == b.start && a.length == b.length && a.program == b.program &&
+                       a.speed == b.speed && a.sin == b.sin && a.reverse == b.reverse && a.fire == b.fire &&
+                       a.cooling == b.cooling && a.sparking == b.sparking && a.columns == b.columns &&
+                       strcmp(a.effect, b.effect) == 0;
+                break;
+            }
+        }
+    }
+    if (same)
+    {
+        return;
+    }
+
+    pool.clear();
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!pool.set(wanted[i]))
+        {
+            Serial.printf("Config file: segment '%s' rejected\n", wanted[i].name);
+        }
+    }
+    Serial.println("Config file: segments applied");
+}
+
+static void applyNetworkSection(JsonObjectConst section)
+{
+    NetworkConfig &network = bootConfig.network;
+
+    const char *apPassword = section["ap_password"];
+    if (apPassword && strcmp(apPassword, CONFIG_SECRET_PLACEHOLDER) != 0)
+    {
+        // softAP() refuses to start with a WPA2 passphrase outside 8 to 63 characters
+        size_t length = strlen(apPassword);
+        if (length >= 8 && length <= 63)
+        {
+            strlcpy(network.apPassword, apPassword, sizeof(network.apPassword));
+        }
+        else
+        {
+            Serial.println("Config file: ap_password must be 8 to 63 characters, keeping the default");
+        }
+    }
+
+    for (JsonObjectConst entry : section["networks"].as<JsonArrayConst>())
+    {
+        const char *ssid = entry["ssid"];
+        if (!ssid)
+        {
+            continue;
+        }
+        const char *password = entry["password"] | "";
+        if (strcmp(password, CONFIG_SECRET_PLACEHOLDER) == 0)
+        {
+            // There's no stored copy of a file network's password to keep
+            Serial.printf("Config file: network '%s' has no password, skipping it\n", ssid);
+            continue;
+        }
+        if (network.networkCount == CONFIG_MAX_NETWORKS)
+        {
+            Serial.println("Config file: too many networks, ignoring the rest");
+            break;
+        }
+        NetworkEntry &slot = network.networks[network.networkCount++];
+        strlcpy(slot.ssid, ssid, sizeof(slot.ssid));
+        strlcpy(slot.password, password, sizeof(slot.password));
+    }
+}
+
+static void applyIOSection(JsonObjectConst section)
+{
+    bootConfig.io.i2cClock = section["i2c_clock"] | bootConfig.io.i2cClock;
+    bootConfig.io.serial2Baud = section["serial2_baud"] | bootConfig.io.serial2Baud;
+}
+
+// FNV-1a over the whole file, to tell a new file from one already applied
+static uint32_t hashFile(File &file)
+{
+    uint32_t hash = 2166136261u;
+    uint8_t chunk[64];
+    size_t length;
+    while ((length = file.read(chunk, sizeof(chunk))) > 0)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            hash = (hash ^ chunk[i]) * 16777619u;
+        }
+    }
+    file.seek(0);
+    return hash;
+}
+
+/**
+ * Reads the config file one top-level member at a time. Each key is parsed on
+ * its own, then its value, so the largest allocation is a single section.
+ *
+ * "strips", "network" and "io" are applied on every boot. "lighting" and
+ * "segments" can be changed from the UI as well, so they're only applied the
+ * first time a given file is seen; after that the stored settings win.
+ *
+ * @param path The file to read.
+ * @return true if the file was found and parsed to the end.
+ */
+bool loadConfigFile(const char *path)
+{
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file)
+    {
+        Serial.printf("Config file %s not found, using stored settings\n", path);
+        return false;
+    }
+
+    uint32_t fileHash = hashFile(file);
+    bool newFile = (uint32_t)PreferencesManager::getInt(CONFIG_FILE_HASH_KEY, 0) != fileHash;
+    if (!newFile)
+    {
+        Serial.println("Config file: already applied, keeping the stored lighting and segments");
+    }
+
+    // Stream::find() waits for more data until the timeout, which a file at EOF never gets
+    file.setTimeout(0);
+
+    if (!file.find('{'))
+    {
+        Serial.println("Config file: expected an object");
+        file.close();
+        return false;
+    }
+
+    bool ok = true;
+    while (true)
+    {
+        JsonDocument keyDoc;
+        DeserializationError error = deserializeJson(keyDoc, file);
+        if (error || !keyDoc.is<const char *>())
+        {
+            // An empty object lands here too, which is fine
+            ok = error == DeserializationError::InvalidInput;
+            break;
+        }
+
+        char key[16];
+        strlcpy(key, keyDoc.as<const char *>(), sizeof(key));
+
+        if (!file.find(':'))
+        {
+            ok = false;
+            break;
+        }
+
+        JsonDocument section;
+        error = deserializeJson(section, file, DeserializationOption::NestingLimit(4));
+        if (error)
+        {
+            Serial.printf("Config file: section '%s' failed to parse: %s\n", key, error.c_str());
+            ok = false;
+            break;
+        }
+
+        if (strcmp(key, "lighting") == 0)
+        {
+            if (newFile)
+            {
+                applyLightingSection(section.as<JsonObjectConst>());
+            }
+        }
+        else if (strcmp(key, "strips") == 0)
+        {
+            applyStripsSection(section.as<JsonArrayConst>());
+        }
+        else if (strcmp(key, "segments") == 0)
+        {
+            if (newFile)
+            {
+                applySegmentsSection(section.as<JsonArrayConst>());
+            }
+        }
+        else if (strcmp(key, "network") == 0)
+        {
+            applyNetworkSection(section.as<JsonObjectConst>());
+        }
+        else if (strcmp(key, "io") == 0)
+        {
+            applyIOSection(section.as<JsonObjectConst>());
+        }
+        else
+        {
+            Serial.printf("Config file: ignoring unknown section '%s'\n", key);
+        }
+
+        // Either another member follows or the object ends
+        if (!file.findUntil(",", "}"))
+        {
+            break;
+        }
+    }
+
+    file.close();
+    if (ok && newFile)
+    {
+        PreferencesManager::setInt(CONFIG_FILE_HASH_KEY, (int)fileHash);
+    }
+    Serial.printf("Config file %s %s\n", path, ok ? "loaded" : "had errors");
+    return ok;
+}
+
+// Stands in for a password in the export, empty ones stay empty
+static const char *exportSecret(const char *secret)
+{
+    return secret[0] ? CONFIG_SECRET_PLACEHOLDER : "";
+}
+
+/**
+ * Writes the running configuration in the config file format, one section at
+ * a time. Passwords are replaced with CONFIG_SECRET_PLACEHOLDER, since this is
+ * served without a login.
+ *
+ * @param out Where to write, eg: a web response stream.
+ */
+void exportConfig(Print &out)
+{
+    out.print("{\"lighting\":");
+    {
+        LightConfig config = lightUtils->getConfig();
+        JsonDocument section;
+        section["brightness"] = config.brightness;
+        section["program"] = config.program;
+        section["sin"] = config.sin;
+        section["updates"] = config.updates;
+        section["reverse"] = config.reverse;
+        section["fire"] = config.fire;
+        section["local_disable"] = config.localDisable;
+        section["auto"] = config.autoLight;
+        section["auto_time"] = config.autoTime;
+        section["reverse_second_row"] = config.reverseSecondRow;
+        section["circular_mode"] = config.circularMode;
+        section["blend_time"] = config.blendTime;
+        section["circular_arms"] = config.circularArms;
+        section["circular_spin"] = config.circularSpin;
+        section["fade_time"] = config.fadeTime;
+        section["fade_curve"] = config.fadeCurve;
+        section["fire_cooling"] = config.fireCooling;
+        section["fire_sparking"] = config.fireSparking;
+        section["fire_columns"] = config.fireColumns;
+        section["effect"] = config.effect;
+        section["text"] = config.text;
+        section["particle_cap"] = config.particleCap;
+        serializeJson(section, out);
+    }
+
+    out.print(",\"strips\":");
+    {
+        JsonDocument section;
+        JsonArray strips = section.to<JsonArray>();
+        for (uint8_t i = 0; i < MAX_STRIPS; i++)
+        {
+            const ColorSettings &color = bootConfig.strips.color[i];
+            char correction[8];
+            snprintf(correction, sizeof(correction), "#%06X", color.correction);
+
+            JsonObject entry = strips.add<JsonObject>();
+            entry["leds"] = bootConfig.strips.leds[i];
+            entry["gamma"] = color.gamma;
+            entry["correction"] = correction;
+            entry["dither"] = color.dither;
+            entry["max_ma"] = bootConfig.strips.maxMilliamps[i];
+        }
+        serializeJson(section, out);
+    }
+
+    out.print(",\"segments\":");
+    {
+        SegmentConfig segments[MAX_SEGMENTS];
+        uint8_t count = lightUtils->getSegments().list(segments);
+        JsonDocument section;
+        JsonArray list = section.to<JsonArray>();
+        for (uint8_t i = 0; i < count; i++)
+        {
+            JsonObject entry = list.add<JsonObject>();
+            entry["name"] = segments[i].name;
+            entry["start"] = segments[i].start;
+            entry["length"] = segments[i].length;
+            entry["program"] = segments[i].program;
+            entry["speed"] = segments[i].speed;
+            entry["sin"] = segments[i].sin;
+            entry["reverse"] = segments[i].reverse;
+            entry["fire"] = segments[i].fire;
+            entry["cooling"] = segments[i].cooling;
+            entry["sparking"] = segments[i].sparking;
+            entry["columns"] = segments[i].columns;
+            entry["effect"] = segments[i].effect;
+        }
+        serializeJson(section, out);
+    }
+
+    out.print(",\"network\":");
+    {
+        const NetworkConfig &network = bootConfig.network;
+        JsonDocument section;
+        section["ap_password"] = exportSecret(network.apPassword);
+        JsonArray networks = section["networks"].to<JsonArray>();
+        for (uint8_t i = 0; i < network.networkCount; i++)
+        {
+            JsonObject entry = networks.add<JsonObject>();
+            entry["ssid"] = network.networks[i].ssid;
+            entry["password"] = exportSecret(network.networks[i].password);
+        }
+        serializeJson(section, out);
+    }
+
+    out.print(",\"io\":");
+    {
+        JsonDocument section;
+        section["i2c_clock"] = bootConfig.io.i2cClock;
+        section["serial2_baud"] = bootConfig.io.serial2Baud;
+        serializeJson(section, out);
+    }
+
+    out.print("}");
+}
@@ -0,0 +1,68 @@
+#ifndef CONFIGFILE_H
+#define CONFIGFILE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "configuration.h"
+#include "PixelArena.h"
+
+#define CONFIG_FILE "/config.json"
+#define CONFIG_MAX_NETWORKS 8
+#define CONFIG_SECRET_PLACEHOLDER "********" // Exported instead of passwords; read back, it keeps the current value
+#define CONFIG_FILE_HASH_KEY "cfgFileHash"   // Hash of the last file whose lighting and segments were applied
+
+/*
+    Provisioning file support.
+
+    CONFIG_FILE is a JSON object with optional "lighting", "strips",
+    "segments", "network" and "io" sections. It's read one section at a time
+    straight from LittleFS, so only the section being applied is ever held in
+    heap. Anything missing from the file keeps its stored or compiled-in value.
+    "lighting" and "segments" are only applied once per file, so changes made
+    from the UI survive a reboot.
+
+    The export leaves passwords out, writing CONFIG_SECRET_PLACEHOLDER in
+    their place, so an exported file can be loaded back as it is.
+
+    {
+        "lighting": { "brightness": 128, "program": 4, "fire": false, ... },
+        "strips": [ { "leds": 30, "gamma": 2.2, "correction": "#FFB0F0", "dither": true, "max_ma": 2000 }, { "leds": 60 } ],
+        "segments": [ { "name": "top", "start": 0, "length": 12, "program": 3, "speed": 2 }, ... ],
+        "network": { "ap_password": "...", "networks": [ { "ssid": "...", "password": "..." } ] },
+        "io": { "i2c_clock": 400000, "serial2_baud": 921600 }
+    }
+*/
+
+struct NetworkEntry
+{
+    char ssid[33];
+    char password[65];
+};
+
+struct NetworkConfig
+{
+    char apPassword[65] = "dragonsofeden";
+    uint8_t networkCount = 0; // Networks from the file, added on top of wifi_config.h
+    NetworkEntry networks[CONFIG_MAX_NETWORKS];
+};
+
+struct IOConfig
+{
+    uint32_t i2cClock = 400000UL;
+    uint32_t serial2Baud = NOVANET_BAUD;
+};
+
+struct BootConfig
+{
+    StripLayout strips; // Only read at boot, a change needs a restart
+    NetworkConfig network;
+    IOConfig io;
+};
+
+extern BootConfig bootConfig;
+
+bool loadConfigFile(const char *path); // Applies a new file's "lighting" and "segments", fills bootConfig with the rest
+void exportConfig(Print &out);         // Writes the running configuration in the same format
+
+#endif
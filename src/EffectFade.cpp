@@ -0,0 +1,93 @@
+#include "EffectFade.h"
+
+/**
+ * Hands over the two render buffers. Each must hold every LED.
+ */
+void EffectFade::begin(CRGB *outgoingBuffer, CRGB *incomingBuffer)
+{
+    buffers[0] = outgoingBuffer;
+    buffers[1] = incomingBuffer;
+}
+
+/**
+ * Starts a crossfade away from an effect. Starting another one part way
+ * through restarts from the effect given, which is the one that was fading
+ * in, so the frame never jumps further than one effect's difference.
+ *
+ * @param from The effect that was showing until now.
+ * @param now millis() at the start of the frame.
+ */
+void EffectFade::start(Effect *from, uint32_t now)
+{
+    if (!from || !buffers[0] || !durationMs)
+    {
+        progress = 255;
+        return;
+    }
+    outgoing = from;
+    startMs = now;
+    progress = 0;
+    amount = 0;
+}
+
+void EffectFade::setDuration(uint16_t ms)
+{
+    durationMs = ms;
+}
+
+void EffectFade::setCurve(FadeCurve fadeCurve)
+{
+    curve = fadeCurve < FadeCurve::Count ? fadeCurve : FadeCurve::EaseInOut;
+}
+
+/**
+ * Advances the fade to now. Call once per frame, before rendering.
+ */
+bool EffectFade::step(uint32_t now)
+{
+    if (progress == 255)
+    {
+        return false;
+    }
+
+    uint32_t elapsed = now - startMs;
+    if (!durationMs || elapsed >= durationMs)
+    {
+        progress = 255;
+        outgoing = NULL;
+        return false;
+    }
+    progress = (elapsed * 255) / durationMs;
+
+    switch (curve)
+    {
+    case FadeCurve::Linear:
+        amount = progress;
+        break;
+    case FadeCurve::EaseIn:
+        amount = scale8(progress, progress);
+        break;
+    default:
+        amount = ease8InOutCubic(progress);
+        break;
+    }
+    return true;
+}
+
+/**
+ * Blends the two buffers into leds for a run of logical pixels.
+ *
+ * @param leds The frame being rendered.
+ * @param table Physical index of each logical pixel in the run.
+ * @param count Pixels in the run.
+ */
+void EffectFade::mix(CRGB *leds, const uint16_t *table, uint16_t count) const
+{
+    const CRGB *from = buffers[0];
+    const CRGB *to = buffers[1];
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint16_t p = table[i];
+        leds[p] = blend(from[p], to[p], amount);
+    }
+}
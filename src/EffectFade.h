@@ -0,0 +1,58 @@
+#ifndef EFFECTFADE_H
+#define EFFECTFADE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "effects/Effect.h"
+
+/*
+    Shape of an effect crossfade, stored in LightConfig::fadeCurve.
+*/
+enum class FadeCurve : uint8_t
+{
+    Linear,    // Constant rate
+    EaseInOut, // Slow at both ends, the default
+    EaseIn,    // Holds the outgoing effect longer, then hands over quickly
+    Count
+};
+
+/*
+    A timed crossfade from one effect to another.
+
+    While it runs, the outgoing and incoming effects each render into their
+    own buffer and mix() blends the two into the frame along the configured
+    curve. The buffers come from the LED arena in LightUtils::begin() and are
+    reused by every transition, so starting one never allocates.
+
+    Like PaletteBlend, it does no work once the transition has finished.
+*/
+class EffectFade
+{
+private:
+    CRGB *buffers[2] = {NULL, NULL}; // Outgoing, incoming
+    Effect *outgoing = NULL;
+    uint32_t startMs = 0;
+    uint16_t durationMs = 0;
+    FadeCurve curve = FadeCurve::EaseInOut;
+    uint8_t progress = 255; // 255 once the incoming effect has taken over
+    uint8_t amount = 255;   // progress through the curve
+
+public:
+    void begin(CRGB *outgoingBuffer, CRGB *incomingBuffer);
+    void start(Effect *from, uint32_t now); // Fade from this effect to whatever renders next
+    void setDuration(uint16_t ms);
+    void setCurve(FadeCurve fadeCurve);
+    bool step(uint32_t now); // Returns true while the fade is running
+
+    void mix(CRGB *leds, const uint16_t *table, uint16_t count) const; // Blend mapped pixels into leds
+
+    bool isActive(void) const { return progress < 255; }
+    Effect *getOutgoing(void) const { return outgoing; }
+    CRGB *getOutgoingBuffer(void) const { return buffers[0]; }
+    CRGB *getIncomingBuffer(void) const { return buffers[1]; }
+    uint8_t getProgress(void) const { return progress; }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline()
+{
+    freeFrames = xQueueCreate(FRAME_BUFFERS, sizeof(Frame *));
+    readyFrames = xQueueCreate(FRAME_BUFFERS, sizeof(Frame *));
+}
+
+/**
+ * Points the frames at their pixel buffers and makes them available to the
+ * render task. Until this runs acquire() blocks.
+ */
+void FramePipeline::begin(CRGB *buffers, uint16_t numLeds)
+{
+    for (uint8_t i = 0; i < FRAME_BUFFERS; i++)
+    {
+        frames[i].leds = buffers + i * numLeds;
+        fill_solid(frames[i].leds, numLeds, CRGB::Black);
+        frames[i].brightness = 0;
+        frames[i].blank = true;
+
+        Frame *frame = &frames[i];
+        xQueueSend(freeFrames, &frame, 0);
+    }
+}
+
+Frame *FramePipeline::getFrame(uint8_t index)
+{
+    return &frames[index];
+}
+
+Frame *FramePipeline::acquire(void)
+{
+    Frame *frame = NULL;
+    xQueueReceive(freeFrames, &frame, portMAX_DELAY);
+    return frame;
+}
+
+void FramePipeline::submit(Frame *frame)
+{
+    xQueueSend(readyFrames, &frame, portMAX_DELAY);
+}
+
+Frame *FramePipeline::next(void)
+{
+    Frame *frame = NULL;
+    xQueueReceive(readyFrames, &frame, portMAX_DELAY);
+    return frame;
+}
+
+void FramePipeline::release(Frame *frame)
+{
+    xQueueSend(freeFrames, &frame, portMAX_DELAY);
+}
+
+void FramePipeline::recordOutput(uint32_t outputUs)
+{
+    lastOutputUs = outputUs;
+    if (outputUs > maxOutputUs)
+    {
+        maxOutputUs = outputUs;
+    }
+    outputFrames++;
+}
+
+/**
+ * Counts a frame the output stage didn't push because nothing changed. The
+ * time saved is estimated from the last push.
+ *
+ * @param checkUs What finding out the frame was unchanged cost.
+ */
+void FramePipeline::recordSkip(uint32_t checkUs)
+{
+    skippedFrames++;
+    if (lastOutputUs > checkUs)
+    {
+        savedOutputUs += lastOutputUs - checkUs;
+    }
+}
+
+uint32_t FramePipeline::getOutputFrames(void)
+{
+    return outputFrames;
+}
+
+uint32_t FramePipeline::getLastOutputUs(void)
+{
+    return lastOutputUs;
+}
+
+uint32_t FramePipeline::getMaxOutputUs(void)
+{
+    return maxOutputUs;
+}
+
+uint32_t FramePipeline::getSkippedFrames(void)
+{
+    return skippedFrames;
+}
+
+uint64_t FramePipeline::getSavedOutputUs(void)
+{
+    return savedOutputUs;
+}
@@ -0,0 +1,67 @@
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "configuration.h"
+
+#define FRAME_BUFFERS 2
+
+/*
+    One rendered frame, plus what the output stage needs to push it.
+*/
+struct Frame
+{
+    CRGB *leds = NULL; // numLeds pixels, in the pixel arena
+    uint8_t brightness;
+    bool blank; // Push black instead of the pixels (local disable)
+};
+
+/*
+    Double-buffered hand-off between the render task and the output task.
+
+    Buffers circulate through two queues: the render task takes a free buffer,
+    fills it and submits it; the output task takes the submitted buffer, pushes
+    it to the strip and releases it. While one frame is being clocked out the
+    next one is already being rendered into the other buffer, so the frame
+    time is set by the slower of the two stages rather than their sum.
+*/
+class FramePipeline
+{
+private:
+    Frame frames[FRAME_BUFFERS];
+    QueueHandle_t freeFrames;  // Buffers the render task may fill
+    QueueHandle_t readyFrames; // Buffers waiting for the output task
+
+    uint32_t outputFrames = 0;
+    uint32_t lastOutputUs = 0;
+    uint32_t maxOutputUs = 0;
+    uint32_t skippedFrames = 0;
+    uint64_t savedOutputUs = 0; // Output stage time not spent on skipped frames
+
+public:
+    FramePipeline();
+    void begin(CRGB *buffers, uint16_t numLeds); // FRAME_BUFFERS * numLeds pixels, laid out back to back
+
+    Frame *getFrame(uint8_t index); // Direct access, for setting up the output driver
+
+    // Render task side
+    Frame *acquire(void);      // Blocks until the output stage has finished with a buffer
+    void submit(Frame *frame); // Hand a finished frame to the output stage
+
+    // Output task side
+    Frame *next(void);          // Blocks until a frame is submitted
+    void release(Frame *frame); // Return the buffer once it's been pushed
+    void recordOutput(uint32_t outputUs);
+    void recordSkip(uint32_t checkUs); // An unchanged frame that wasn't pushed
+
+    uint32_t getOutputFrames(void);
+    uint32_t getLastOutputUs(void);
+    uint32_t getMaxOutputUs(void);
+    uint32_t getSkippedFrames(void);
+    uint64_t getSavedOutputUs(void);
+};
+
+#endif
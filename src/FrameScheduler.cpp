@@ -0,0 +1,112 @@
+#include "FrameScheduler.h"
+
+void FrameScheduler::onTimer(void *arg)
+{
+    FrameScheduler *scheduler = (FrameScheduler *)arg;
+    xTaskNotifyGive(scheduler->task);
+}
+
+/**
+ * Sets the frame rate. The timer is created on first use and bound to the
+ * calling task, so this must be called from the render task.
+ *
+ * @param framesPerSecond The target rate. 0 is treated as 1.
+ */
+void FrameScheduler::setRate(uint16_t framesPerSecond)
+{
+    if (framesPerSecond == 0)
+    {
+        framesPerSecond = 1;
+    }
+    if (framesPerSecond == rate && timer)
+    {
+        return;
+    }
+
+    if (!timer)
+    {
+        task = xTaskGetCurrentTaskHandle();
+
+        esp_timer_create_args_t args = {};
+        args.callback = &FrameScheduler::onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "frame";
+        args.skip_unhandled_events = true;
+
+        esp_err_t err = esp_timer_create(&args, &timer);
+        if (err != ESP_OK)
+        {
+            Serial.printf("FrameScheduler: timer create failed: %s\n", esp_err_to_name(err));
+            timer = NULL;
+            return;
+        }
+    }
+    else
+    {
+        esp_timer_stop(timer);
+    }
+
+    rate = framesPerSecond;
+    periodUs = 1000000UL / framesPerSecond;
+    esp_timer_start_periodic(timer, periodUs);
+}
+
+/**
+ * Blocks until the next frame deadline.
+ */
+void FrameScheduler::waitForFrame(void)
+{
+    if (!timer)
+    {
+        // No timer (setRate() not called, or it failed). Fall back to a plain delay.
+        vTaskDelay(pdMS_TO_TICKS(periodUs ? periodUs / 1000 : 10));
+        frameStartUs = esp_timer_get_time();
+        return;
+    }
+
+    uint32_t deadlines = ulTaskNotifyTake(pdTRUE, 0);
+    if (deadlines)
+    {
+        // The last frame ran into this deadline. Yield anyway, so a run of
+        // heavy frames doesn't starve tasks at the same priority. A yield
+        // rather than a delay, so the late frame doesn't get later still.
+        missedDeadlines++;
+        taskYIELD();
+        deadlines += ulTaskNotifyTake(pdTRUE, 0);
+    }
+    else
+    {
+        deadlines = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    if (deadlines > 1)
+    {
+        droppedFrames += deadlines - 1;
+    }
+    frameStartUs = esp_timer_get_time();
+}
+
+void FrameScheduler::frameDone(void)
+{
+    lastFrameUs = (uint32_t)(esp_timer_get_time() - frameStartUs);
+    if (lastFrameUs > maxFrameUs)
+    {
+        maxFrameUs = lastFrameUs;
+    }
+    totalFrameUs += lastFrameUs;
+    frames++;
+}
+
+FrameScheduler::FrameStats FrameScheduler::getStats(void)
+{
+    FrameStats stats;
+    stats.rate = rate;
+    stats.frames = frames;
+    stats.missedDeadlines = missedDeadlines;
+    stats.droppedFrames = droppedFrames;
+    stats.lastFrameUs = lastFrameUs;
+    stats.maxFrameUs = maxFrameUs;
+    stats.avgFrameUs = frames ? (uint32_t)(totalFrameUs / frames) : 0;
+    return stats;
+}
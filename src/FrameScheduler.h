@@ -0,0 +1,59 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/*
+    Fixed-rate frame pacing for the render task.
+
+    A periodic esp_timer sets the frame deadlines and notifies the render task
+    at each one. The deadlines are absolute, so the time spent rendering and
+    pushing a frame doesn't stretch the period and the rate doesn't drift.
+
+    If a frame overruns, the deadlines it missed pile up as notifications.
+    waitForFrame() collapses them into one, counts the rest as dropped frames
+    and carries on from the next deadline, rather than rendering a burst of
+    late frames to catch up. An overrunning frame finds its deadline already
+    notified and wouldn't block at all, so the render task then sleeps for a
+    tick to let lower priority work on its core run.
+*/
+class FrameScheduler
+{
+private:
+    esp_timer_handle_t timer = NULL;
+    TaskHandle_t task = NULL;
+    uint16_t rate = 0;
+    uint32_t periodUs = 0;
+
+    int64_t frameStartUs = 0;
+    uint32_t frames = 0;
+    uint32_t missedDeadlines = 0;
+    uint32_t droppedFrames = 0;
+    uint32_t lastFrameUs = 0;
+    uint32_t maxFrameUs = 0;
+    uint64_t totalFrameUs = 0;
+
+    static void onTimer(void *arg);
+
+public:
+    struct FrameStats
+    {
+        uint16_t rate;            // Target frames per second
+        uint32_t frames;          // Frames rendered
+        uint32_t missedDeadlines; // Frames that ran past at least one deadline
+        uint32_t droppedFrames;   // Deadlines skipped because of an overrun
+        uint32_t lastFrameUs;     // Time spent on the most recent frame
+        uint32_t maxFrameUs;
+        uint32_t avgFrameUs;
+    };
+
+    void setRate(uint16_t framesPerSecond); // Safe to call every frame, only restarts the timer on a change
+    void waitForFrame(void);                // Blocks the calling task until the next deadline
+    void frameDone(void);                   // Marks the end of the frame's work
+    FrameStats getStats(void);
+};
+
+#endif
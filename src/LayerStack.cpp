@@ -0,0 +1,337 @@
+#include "LayerStack.h"
+#include "PixelArena.h"
+
+static uint16_t maskWords(uint16_t ledCount)
+{
+    return (ledCount + LAYER_WORD_BITS - 1) / LAYER_WORD_BITS;
+}
+
+// Names that fit a Layer whole; a longer one would be stored cut short and
+// never be found again
+static bool validName(const char *name)
+{
+    return name[0] && strlen(name) < LAYER_NAME_LENGTH;
+}
+
+/**
+ * Storage for the staging and live copy of every layer.
+ */
+size_t LayerStack::arenaBytes(uint16_t ledCount)
+{
+    return 2 * MAX_LAYERS * (PixelArena::footprint<uint32_t>(maskWords(ledCount)) + PixelArena::footprint<CRGB>(ledCount));
+}
+
+void LayerStack::begin(uint32_t *storage, uint16_t ledCount)
+{
+    numLeds = ledCount;
+    words = maskWords(ledCount);
+    editMutex = xSemaphoreCreateMutex();
+
+    size_t colorWords = PixelArena::footprint<CRGB>(ledCount) / sizeof(uint32_t);
+    Layer *copies[2] = {staging, live};
+    for (uint8_t c = 0; c < 2; c++)
+    {
+        for (uint8_t i = 0; i < MAX_LAYERS; i++)
+        {
+            copies[c][i].mask = storage;
+            storage += words;
+            copies[c][i].colors = (CRGB *)storage;
+            storage += colorWords;
+            resetLayer(copies[c][i]);
+        }
+    }
+}
+
+/**
+ * Covers first to last, inclusive, with color. The layer is created on top
+ * of the stack if there isn't one with this name; an existing layer takes
+ * the new blend and alpha.
+ *
+ * @return false if the name is empty or too long, the range is outside the
+ *         strip, or the stack is full.
+ */
+bool LayerStack::setRange(const char *name, uint16_t first, uint16_t last, CRGB color, LayerBlend blend, uint8_t alpha)
+{
+    if (!editMutex || !validName(name) || first > last || last >= numLeds || blend >= LayerBlend::Count)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(editMutex, portMAX_DELAY);
+    int8_t slot = findLayer(name);
+    if (slot < 0)
+    {
+        slot = findLayer("");
+        if (slot >= 0)
+        {
+            strlcpy(staging[slot].name, name, LAYER_NAME_LENGTH);
+        }
+    }
+    if (slot < 0)
+    {
+        xSemaphoreGive(editMutex);
+        Serial.println("Layer stack is full");
+        return false;
+    }
+
+    Layer &layer = staging[slot];
+    layer.blend = blend;
+    layer.alpha = alpha;
+    for (uint16_t i = first; i <= last; i++)
+    {
+        layer.mask[i / LAYER_WORD_BITS] |= 1u << (i % LAYER_WORD_BITS);
+        layer.colors[i] = color;
+    }
+
+    uint16_t firstWord = first / LAYER_WORD_BITS;
+    uint16_t endWord = last / LAYER_WORD_BITS + 1;
+    if (layer.firstWord == layer.endWord)
+    {
+        layer.firstWord = firstWord;
+        layer.endWord = endWord;
+    }
+    else
+    {
+        layer.firstWord = min(layer.firstWord, firstWord);
+        layer.endWord = max(layer.endWord, endWord);
+    }
+
+    dirty |= 1 << slot;
+    pending = true;
+    xSemaphoreGive(editMutex);
+    return true;
+}
+
+/**
+ * Removes a layer. The layers above it move down, so the stack keeps its
+ * order and new layers always go on top.
+ */
+bool LayerStack::remove(const char *name)
+{
+    if (!editMutex || !validName(name))
+    {
+        return false;
+    }
+
+    xSemaphoreTake(editMutex, portMAX_DELAY);
+    int8_t slot = findLayer(name);
+    if (slot >= 0)
+    {
+        // Rotate the freed storage to the top
+        Layer removed = staging[slot];
+        for (uint8_t i = slot; i + 1 < MAX_LAYERS; i++)
+        {
+            staging[i] = staging[i + 1];
+            dirty |= 1 << i;
+        }
+        staging[MAX_LAYERS - 1] = removed;
+        resetLayer(staging[MAX_LAYERS - 1]);
+        dirty |= 1 << (MAX_LAYERS - 1);
+        pending = true;
+    }
+    xSemaphoreGive(editMutex);
+    return slot >= 0;
+}
+
+void LayerStack::clear(void)
+{
+    if (!editMutex)
+    {
+        return;
+    }
+
+    xSemaphoreTake(editMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_LAYERS; i++)
+    {
+        if (staging[i].name[0])
+        {
+            resetLayer(staging[i]);
+            dirty |= 1 << i;
+        }
+    }
+    pending = dirty != 0;
+    xSemaphoreGive(editMutex);
+}
+
+bool LayerStack::covers(uint16_t index)
+{
+    if (!editMutex || index >= numLeds)
+    {
+        return false;
+    }
+
+    bool covered = false;
+    xSemaphoreTake(editMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_LAYERS && !covered; i++)
+    {
+        covered = staging[i].mask[index / LAYER_WORD_BITS] & (1u << (index % LAYER_WORD_BITS));
+    }
+    xSemaphoreGive(editMutex);
+    return covered;
+}
+
+/**
+ * Writes the layer names, bottom of the stack first.
+ *
+ * @return The number of layers.
+ */
+uint8_t LayerStack::list(char *out, size_t size)
+{
+    uint8_t count = 0;
+    out[0] = '\0';
+    if (!editMutex)
+    {
+        return 0;
+    }
+
+    xSemaphoreTake(editMutex, portMAX_DELAY);
+    for (uint8_t i = 0; i < MAX_LAYERS && staging[i].name[0]; i++)
+    {
+        if (count++)
+        {
+            strlcat(out, ",", size);
+        }
+        strlcat(out, staging[i].name, size);
+    }
+    xSemaphoreGive(editMutex);
+    return count;
+}
+
+/**
+ * Copies the layers edited since the last frame into the render task's copy.
+ * If an edit is in progress the copy is left for the next frame rather than
+ * waiting for it.
+ *
+ * @return true if the layers changed.
+ */
+bool LayerStack::apply(void)
+{
+    if (!pending || xSemaphoreTake(editMutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < MAX_LAYERS; i++)
+    {
+        if (!(dirty & (1 << i)))
+        {
+            continue;
+        }
+        const Layer &from = staging[i];
+        Layer &to = live[i];
+        memcpy(to.name, from.name, LAYER_NAME_LENGTH);
+        to.blend = from.blend;
+        to.alpha = from.alpha;
+        to.firstWord = from.firstWord;
+        to.endWord = from.endWord;
+        memcpy(to.mask, from.mask, words * sizeof(uint32_t));
+
+        // Colors only matter where the mask is set
+        uint16_t firstPixel = from.firstWord * LAYER_WORD_BITS;
+        uint16_t endPixel = min((uint16_t)(from.endWord * LAYER_WORD_BITS), numLeds);
+        if (endPixel > firstPixel)
+        {
+            memcpy(to.colors + firstPixel, from.colors + firstPixel, (endPixel - firstPixel) * sizeof(CRGB));
+        }
+    }
+    dirty = 0;
+    pending = false;
+
+    liveCount = 0;
+    while (liveCount < MAX_LAYERS && live[liveCount].name[0])
+    {
+        liveCount++;
+    }
+    xSemaphoreGive(editMutex);
+    return true;
+}
+
+template <LayerBlend Mode>
+static inline void blendPixel(CRGB &pixel, const CRGB &color, uint8_t alpha)
+{
+    switch (Mode)
+    {
+    case LayerBlend::Add:
+        pixel += color;
+        break;
+    case LayerBlend::Alpha:
+        pixel = blend(pixel, color, alpha);
+        break;
+    default:
+        pixel = color;
+        break;
+    }
+}
+
+template <LayerBlend Mode>
+static void compositeLayer(CRGB *leds, const Layer &layer)
+{
+    for (uint16_t w = layer.firstWord; w < layer.endWord; w++)
+    {
+        uint32_t bits = layer.mask[w];
+        if (!bits)
+        {
+            continue;
+        }
+
+        uint16_t base = w * LAYER_WORD_BITS;
+        if (Mode == LayerBlend::Replace && bits == 0xFFFFFFFFu)
+        {
+            memcpy(leds + base, layer.colors + base, LAYER_WORD_BITS * sizeof(CRGB));
+            continue;
+        }
+        while (bits)
+        {
+            uint16_t i = base + __builtin_ctz(bits);
+            bits &= bits - 1;
+            blendPixel<Mode>(leds[i], layer.colors[i], layer.alpha);
+        }
+    }
+}
+
+/**
+ * Blends every layer over the frame, bottom first.
+ */
+void LayerStack::composite(CRGB *leds) const
+{
+    for (uint8_t i = 0; i < liveCount; i++)
+    {
+        const Layer &layer = live[i];
+        switch (layer.blend)
+        {
+        case LayerBlend::Add:
+            compositeLayer<LayerBlend::Add>(leds, layer);
+            break;
+        case LayerBlend::Alpha:
+            compositeLayer<LayerBlend::Alpha>(leds, layer);
+            break;
+        default:
+            compositeLayer<LayerBlend::Replace>(leds, layer);
+            break;
+        }
+    }
+}
+
+// Call with editMutex held
+int8_t LayerStack::findLayer(const char *name)
+{
+    for (uint8_t i = 0; i < MAX_LAYERS; i++)
+    {
+        bool used = staging[i].name[0] != '\0';
+        if (name[0] ? (used && strcmp(staging[i].name, name) == 0) : !used)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void LayerStack::resetLayer(Layer &layer)
+{
+    layer.name[0] = '\0';
+    layer.blend = LayerBlend::Replace;
+    layer.alpha = 255;
+    layer.firstWord = 0;
+    layer.endWord = 0;
+    memset(layer.mask, 0, words * sizeof(uint32_t));
+}
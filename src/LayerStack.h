@@ -0,0 +1,84 @@
+#ifndef LAYERSTACK_H
+#define LAYERSTACK_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#define MAX_LAYERS 4
+#define LAYER_NAME_LENGTH 16 // Including the terminator
+#define LAYER_WORD_BITS 32
+#define PROTECTED_LAYER "protected" // Layer behind protectLedRange()
+
+/*
+    How a layer's pixels combine with what's under them.
+*/
+enum class LayerBlend : uint8_t
+{
+    Replace, // The layer's color
+    Add,     // Saturating add
+    Alpha,   // Mixed in by the layer's alpha
+    Count
+};
+
+/*
+    One overlay. Coverage is a packed bitmask over physical pixels, one bit
+    per pixel, with a color for each covered pixel. firstWord and endWord
+    bound the mask words that have any bit set.
+*/
+struct Layer
+{
+    char name[LAYER_NAME_LENGTH] = ""; // Empty marks a free slot
+    LayerBlend blend = LayerBlend::Replace;
+    uint8_t alpha = 255;
+    uint16_t firstWord = 0;
+    uint16_t endWord = 0; // One past the last word, equal to firstWord when nothing is covered
+    uint32_t *mask = NULL;
+    CRGB *colors = NULL;
+};
+
+/*
+    Overlay layers composited over the rendered frame, in the order they were
+    created.
+
+    The web and API side edits a staging copy under a mutex. At the start of
+    a frame the render task copies the layers that changed into its own copy,
+    taking the mutex without waiting, so an edit never stalls or tears a
+    frame; a frame that finds it busy picks the edit up on the next one.
+
+    composite() walks each layer's mask a word at a time between firstWord
+    and endWord. Empty words are skipped outright and fully covered words of
+    a replace layer are copied 32 pixels at once.
+*/
+class LayerStack
+{
+private:
+    Layer staging[MAX_LAYERS];
+    Layer live[MAX_LAYERS];
+    uint8_t liveCount = 0;
+    uint16_t numLeds = 0;
+    uint16_t words = 0;
+    SemaphoreHandle_t editMutex = NULL;
+    uint8_t dirty = 0;             // Staging slots changed since the last apply(), under editMutex
+    volatile bool pending = false; // dirty != 0, read without the mutex
+
+    int8_t findLayer(const char *name);
+    void resetLayer(Layer &layer);
+
+public:
+    static size_t arenaBytes(uint16_t ledCount);
+    void begin(uint32_t *storage, uint16_t ledCount); // arenaBytes() worth of storage
+
+    bool setRange(const char *name, uint16_t first, uint16_t last, CRGB color, LayerBlend blend, uint8_t alpha); // Add pixels to a layer, creating it
+    bool remove(const char *name);
+    void clear(void);
+    bool covers(uint16_t index); // Any layer covers this physical pixel
+    uint8_t list(char *out, size_t size); // Comma separated names, bottom first
+
+    bool apply(void);                            // Render task only, at the start of a frame
+    void composite(CRGB *leds) const;            // Render task only, after the effects
+    uint8_t getCount(void) const { return liveCount; }
+};
+
+#endif
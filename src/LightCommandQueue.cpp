@@ -0,0 +1,126 @@
+#include "LightCommandQueue.h"
+
+LightCommandQueue::LightCommandQueue()
+{
+    for (uint8_t i = 0; i < (uint8_t)LightParam::Count; i++)
+    {
+        values[i].store(0, std::memory_order_relaxed);
+    }
+    pending.store(0, std::memory_order_relaxed);
+    sequence.store(0, std::memory_order_relaxed);
+    posted.store(0, std::memory_order_relaxed);
+    coalesced.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Queues a new value for a parameter. If the previous value hasn't been
+ * taken yet it's simply replaced.
+ *
+ * @param param The parameter to change.
+ * @param value The new value.
+ */
+void LightCommandQueue::post(LightParam param, uint32_t value)
+{
+    uint32_t bit = 1UL << (uint8_t)param;
+
+    portENTER_CRITICAL(&writeMux);
+    sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    // The value has to be visible before the bit that announces it
+    values[(uint8_t)param].store(value, std::memory_order_relaxed);
+    uint32_t previous = pending.fetch_or(bit, std::memory_order_release);
+    sequence.fetch_add(1, std::memory_order_release);
+    portEXIT_CRITICAL(&writeMux);
+
+    posted.fetch_add(1, std::memory_order_relaxed);
+    if (previous & bit)
+    {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Queues a value for every parameter at once. All of them are published
+ * together, so the render task applies them on the same frame.
+ *
+ * @param allValues One value per LightParam, in enum order.
+ */
+void LightCommandQueue::postBatch(const uint32_t *allValues)
+{
+    postBatch((1UL << (uint8_t)LightParam::Count) - 1, allValues);
+}
+
+/**
+ * Queues values for several parameters at once. They're written under one
+ * sequence update, so take() gets either all of them or none.
+ *
+ * @param mask Bit (1 << LightParam) set for each parameter to post.
+ * @param allValues One value per LightParam, in enum order. Only the
+ *                  entries in mask are read.
+ */
+void LightCommandQueue::postBatch(uint32_t mask, const uint32_t *allValues)
+{
+    portENTER_CRITICAL(&writeMux);
+    sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint8_t i = 0; i < (uint8_t)LightParam::Count; i++)
+    {
+        if (mask & (1UL << i))
+        {
+            values[i].store(allValues[i], std::memory_order_relaxed);
+        }
+    }
+    uint32_t previous = pending.fetch_or(mask, std::memory_order_release);
+    sequence.fetch_add(1, std::memory_order_release);
+    portEXIT_CRITICAL(&writeMux);
+
+    posted.fetch_add(__builtin_popcount(mask), std::memory_order_relaxed);
+    coalesced.fetch_add(__builtin_popcount(previous & mask), std::memory_order_relaxed);
+}
+
+/**
+ * Claims every pending value. If a post was written while the values were
+ * being read, the claim is handed back and everything waits for the next
+ * frame rather than mixing two posts.
+ *
+ * @param outValues Array of LightParam::Count entries. Only the entries whose
+ *                  bit is set in the return value are written.
+ * @return Bitmask of the parameters that had a pending value.
+ */
+uint32_t LightCommandQueue::take(uint32_t *outValues)
+{
+    uint32_t before = sequence.load(std::memory_order_acquire);
+    if ((before & 1) || pending.load(std::memory_order_relaxed) == 0)
+    {
+        return 0;
+    }
+
+    uint32_t mask = pending.exchange(0, std::memory_order_acquire);
+    for (uint8_t i = 0; i < (uint8_t)LightParam::Count; i++)
+    {
+        if (mask & (1UL << i))
+        {
+            outValues[i] = values[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) != before)
+    {
+        // The slots always hold the latest values, so the bits are all that
+        // needs putting back
+        pending.fetch_or(mask, std::memory_order_relaxed);
+        return 0;
+    }
+    return mask;
+}
+
+uint32_t LightCommandQueue::getPosted(void)
+{
+    return posted.load(std::memory_order_relaxed);
+}
+
+uint32_t LightCommandQueue::getCoalesced(void)
+{
+    return coalesced.load(std::memory_order_relaxed);
+}
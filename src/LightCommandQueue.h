@@ -0,0 +1,77 @@
+#ifndef LIGHTCOMMANDQUEUE_H
+#define LIGHTCOMMANDQUEUE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+    Parameters that can be changed from outside the render task. Each one has
+    a single slot in the queue.
+*/
+enum class LightParam : uint8_t
+{
+    Program,
+    Sin,
+    Brightness,
+    Updates,
+    Reverse,
+    Fire,
+    LocalDisable,
+    AutoLight,
+    AutoTime,
+    ReverseSecondRow,
+    CircularMode,
+    BlendTime,
+    CircularArms,
+    CircularSpin,
+    FadeTime,
+    FadeCurve,
+    FireCooling,
+    FireSparking,
+    FireColumns,
+    Effect, // Strings: the value is ignored and the render task copies them from the shared configuration
+    Text,
+    ParticleCap,
+    Count
+};
+
+/*
+    Lock-free, bounded command queue from the UI/API tasks into the render task.
+
+    There's one value slot per LightParam plus a bitmask of slots with a
+    pending value. post() stores the value and then sets the bit, so a burst of
+    posts to one parameter collapses to the latest value. The render task calls
+    take() once at the start of a frame, which claims every pending bit in one
+    atomic exchange.
+
+    Posts are published through a sequence counter, odd while one is being
+    written. take() checks it around reading the values, and if a post landed
+    meanwhile it puts the bits back and leaves everything for the next frame,
+    so a frame never sees half of a batch. Posting tasks serialize on a short
+    spinlock; the render task never waits.
+*/
+class LightCommandQueue
+{
+private:
+    std::atomic<uint32_t> values[(uint8_t)LightParam::Count];
+    std::atomic<uint32_t> pending;
+    std::atomic<uint32_t> sequence; // Odd while a post is writing its values
+    portMUX_TYPE writeMux = portMUX_INITIALIZER_UNLOCKED;
+    std::atomic<uint32_t> posted;
+    std::atomic<uint32_t> coalesced;
+
+public:
+    LightCommandQueue();
+
+    void post(LightParam param, uint32_t value);  // Any task, only ever waits on another post
+    void postBatch(const uint32_t *allValues);      // Every parameter, claimed by the same take()
+    void postBatch(uint32_t mask, const uint32_t *allValues); // The parameters in mask, claimed by the same take()
+    uint32_t take(uint32_t *outValues);             // Render task only. Returns the mask of params filled in, 0 if a post was in progress.
+
+    uint32_t getPosted(void);
+    uint32_t getCoalesced(void); // Posts that replaced a value the render task hadn't applied yet
+};
+
+#endif
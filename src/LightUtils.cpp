@@ -4,10 +4,6 @@
 #include "main.h"
 #include "utilities/PreferencesManager.h"
 
-CRGBPalette16 currentPalette(CRGB::Black);
-
-CRGBPalette16 targetPalette;
-
 LightUtils *lightUtils = NULL;
 
 DEFINE_GRADIENT_PALETTE(heatmap_gp){
@@ -114,66 +110,579 @@ DEFINE_GRADIENT_PALETTE(white_dot){
     1, 0, 0, 0,
     255, 0, 0, 0};
 
+/**
+ * Brings a stored, imported or recalled configuration inside the limits the
+ * web UI enforces, and terminates its strings.
+ *
+ * @param config The configuration to fix up in place.
+ */
+void sanitizeConfig(LightConfig &config)
+{
+    config.sin = min(config.sin, (uint8_t)32);
+    config.updates = constrain(config.updates, (uint16_t)1, (uint16_t)255);
+    config.autoTime = constrain(config.autoTime, (uint32_t)1, (uint32_t)3600);
+    config.blendTime = min(config.blendTime, (uint16_t)10000);
+    config.circularArms = max(config.circularArms, (uint8_t)1);
+    config.fadeTime = min(config.fadeTime, (uint16_t)10000);
+    if (config.fadeCurve >= (uint8_t)FadeCurve::Count)
+    {
+        config.fadeCurve = (uint8_t)FadeCurve::EaseInOut;
+    }
+    config.fireColumns = max(config.fireColumns, (uint8_t)1);
+    config.effect[sizeof(config.effect) - 1] = '\0';
+    config.text[sizeof(config.text) - 1] = '\0';
+    config.particleCap = constrain(config.particleCap, (uint8_t)1, (uint8_t)MAX_PARTICLES);
+}
+
 LightUtils::LightUtils()
 {
     // Load the light configuration
     Serial.println("LightUtils starting up...");
 
-    Serial.println("Loading stored brightness value...");
-    uint8_t storedBrightness = getCfgBrightness();
+    uint32_t loadStart = micros();
+    loadConfig();
+    Serial.printf("Loaded light configuration in %lu us\n", micros() - loadStart);
+    sanitizeConfig(cfg);
+    frameCfg = cfg;
+
+    segments.load();
+
     Serial.print("Loaded brightness value: ");
-    Serial.println(storedBrightness);
+    Serial.println(cfg.brightness);
+
+    paletteEffect = EffectRegistry::find("palette");
+    circularEffect = EffectRegistry::find("circular");
+    fireEffect = EffectRegistry::find("fire");
+    Serial.printf("%u effects registered\n", EffectRegistry::count());
+
+    Serial.println("Loading light configuration - palette");
+    CRGBPalette16 palette(CRGB::Black);
+    selectPalette(cfg.program, palette);
+    basePalette.reset(palette);
+    renderedProgram = cfg.program;
+
+    // Setup goes in here
+}
+
+#if APA102_USE_SPI_DMA
+// Pins and SPI host for each strip slot
+static const spi_host_device_t stripHosts[MAX_STRIPS] = {APA102_SPI_HOST, APA102_2_SPI_HOST};
+static const int stripDataPins[MAX_STRIPS] = {APA102_DATA, APA102_2_DATA};
+static const int stripClockPins[MAX_STRIPS] = {APA102_CLOCK, APA102_2_CLOCK};
+#endif
+
+/**
+ * Arena bytes needed for count LEDs: every frame buffer plus the per-LED
+ * render state. begin() takes exactly these.
+ */
+static size_t ledArenaBytes(uint16_t count)
+{
+    return PixelArena::footprint<CRGB>(FRAME_BUFFERS * count) +
+           PixelArena::footprint<CRGB>(2 * count) +
+           LayerStack::arenaBytes(count) +
+           PixelArena::footprint<uint8_t>(count) +
+           PixelMap::arenaBytes(count);
+}
+
+/**
+ * Sizes everything per-LED from the strip layout and brings up the output.
+ * Called once, after the config file has been read and before the tasks
+ * start.
+ *
+ * @param stripLayout LED count of each strip slot.
+ * @return false if the LED buffers couldn't be allocated, even for the
+ *         default layout.
+ */
+bool LightUtils::begin(const StripLayout &stripLayout)
+{
+    layout = stripLayout;
+    numLeds = layout.total();
+    if (numLeds == 0 || numLeds > MAX_LEDS)
+    {
+        Serial.printf("Strip layout of %u LEDs is out of range, using the defaults\n", numLeds);
+        layout = StripLayout();
+        numLeds = layout.total();
+    }
+
+    if (!arena.begin(ledArenaBytes(numLeds)))
+    {
+        // A configured layout too big for the heap shouldn't leave the lights
+        // dead, so try the smaller compiled-in one
+        layout = StripLayout();
+        uint16_t fallbackLeds = layout.total();
+        if (fallbackLeds >= numLeds || !arena.begin(ledArenaBytes(fallbackLeds)))
+        {
+            numLeds = 0;
+            return false;
+        }
+        Serial.printf("Not enough memory for %u LEDs, using the default layout of %u\n", numLeds, fallbackLeds);
+        numLeds = fallbackLeds;
+    }
 
+    CRGB *frameBuffers = arena.take<CRGB>(FRAME_BUFFERS * numLeds);
+    CRGB *fadeBuffers = arena.take<CRGB>(2 * numLeds);
+    fade.begin(fadeBuffers, fadeBuffers + numLeds);
+    layers.begin(arena.take<uint32_t>(LayerStack::arenaBytes(numLeds) / sizeof(uint32_t)), numLeds);
+    heat = arena.take<uint8_t>(numLeds);
+    pixelMap.begin(arena.take<uint16_t>(PixelMap::arenaBytes(numLeds) / sizeof(uint16_t)), numLeds);
+
+    pipeline.begin(frameBuffers, numLeds);
+    leds = pipeline.getFrame(0)->leds;
+
+    rebuildPixelMap();
+
+#if APA102_USE_SPI_DMA
+    Serial.println("Configuring APA102 SPI DMA output");
+    uint16_t stripOffset = 0;
+    for (uint8_t i = 0; i < MAX_STRIPS; i++)
+    {
+        // A strip that doesn't come up keeps its pixels in the frame, so
+        // the ones after it stay where the layout put them
+        if (layout.leds[i])
+        {
+            uint8_t index = output.getStripCount();
+            if (output.addStrip(stripHosts[i], stripDataPins[i], stripClockPins[i], stripOffset, layout.leds[i], APA102_SPI_CLOCK_HZ, layout.color[i]))
+            {
+                stripOutput[i] = index;
+            }
+            else
+            {
+                Serial.printf("Strip %u: SPI output failed to start, it stays dark\n", i + 1);
+            }
+        }
+        stripOffset += layout.leds[i];
+    }
+#else
     Serial.println("Configuring FastLED");
-    FastLED.addLeds<APA102, APA102_DATA, APA102_CLOCK, COLOR_ORDER, DATA_RATE_KHZ(4000)>(leds, NUM_LEDS);
-    FastLED.setBrightness(storedBrightness);
+    // The output task repoints the controllers at whichever buffer it's pushing
+    if (layout.leds[0])
+    {
+        ledController = &FastLED.addLeds<APA102, APA102_DATA, APA102_CLOCK, COLOR_ORDER, DATA_RATE_KHZ(4000)>(leds, layout.leds[0]);
+    }
+    if (layout.leds[1])
+    {
+        ledController2 = &FastLED.addLeds<APA102, APA102_2_DATA, APA102_2_CLOCK, COLOR_ORDER, DATA_RATE_KHZ(4000)>(leds + layout.leds[0], layout.leds[1]);
+    }
+    FastLED.setBrightness(cfg.brightness);
     Serial.print("FastLED brightness set to: ");
-    Serial.println(storedBrightness);
+    Serial.println(cfg.brightness);
     FastLED.setDither(0); // Disable dithering for faster performance and because we don't need it for the DMX lights.
 
+    // FastLED has correction and dithering per controller, but no gamma
+    CLEDController *controllers[MAX_STRIPS] = {ledController, ledController2};
+    for (uint8_t i = 0; i < MAX_STRIPS; i++)
+    {
+        if (!controllers[i])
+        {
+            continue;
+        }
+        const ColorSettings &color = layout.color[i];
+        controllers[i]->setCorrection(CRGB(color.correction >> 16, color.correction >> 8, color.correction));
+        controllers[i]->setDither(color.dither ? BINARY_DITHER : DISABLE_DITHER);
+        if (color.gamma != 1.0f)
+        {
+            Serial.printf("Strip %u: gamma needs the SPI DMA output, ignoring it\n", i + 1);
+        }
+    }
+#endif
 
-    Serial.println("Loading light configuration - currentPalette");
-    currentPalette = getPalette((PreferencesManager::getInt("cfgProgram", 1)), false);
+    for (uint8_t i = 0; i < MAX_STRIPS; i++)
+    {
+        power.setBudget(i, layout.maxMilliamps[i]);
+        if (layout.leds[i])
+        {
+            Serial.printf("Strip %u: %u LEDs, %u bytes, %u mA budget\n", i + 1, layout.leds[i], getStripMemory(i), layout.maxMilliamps[i]);
+        }
+    }
+    Serial.printf("LED arena: %u of %u bytes used\n", arena.getUsed(), arena.getCapacity());
 
-    Serial.println("Loading light configuration - cfgSin");
-    cfgSin = getCfgSin();
+    return true;
+}
 
-    Serial.println("Loading light configuration - cfgUpdates");
-    cfgUpdates = getCfgUpdates() ? getCfgUpdates() : 30;
+/**
+ * Loads the configuration blob with a single preferences read. Falls back to
+ * migrating the old one-key-per-setting layout if there's no blob yet.
+ */
+void LightUtils::loadConfig(void)
+{
+    // Sized like saveConfig() writes it, so a LightConfig that outgrows a
+    // journal slot still reads back whole
+    uint8_t blob[sizeof(LightConfigHeader) + sizeof(LightConfig)];
+    size_t length = PreferencesManager::getBytes(LIGHT_CONFIG_KEY, blob, sizeof(blob));
 
-    Serial.println("Loading light configuration - cfgFire");
-    cfgFire = getCfgFire();
+    LightConfigHeader header;
+    if (length < sizeof(header))
+    {
+        Serial.println("No light configuration blob found, migrating stored keys");
+        migrateLegacyConfig();
+        return;
+    }
 
-    Serial.println("Loading light configuration - cfgReverse");
-    cfgReverse = getCfgReverse();
+    memcpy(&header, blob, sizeof(header));
+    if (header.size + sizeof(header) > length)
+    {
+        Serial.println("Light configuration blob is truncated, migrating stored keys");
+        migrateLegacyConfig();
+        return;
+    }
 
-    Serial.println("Loading light configuration - cfgAuto");
-    cfgAuto = getCfgAuto();
+    if (header.version != LIGHT_CONFIG_VERSION)
+    {
+        Serial.printf("Upgrading light configuration from version %u to %u\n", header.version, LIGHT_CONFIG_VERSION);
+    }
 
-    Serial.println("Loading light configuration - cfgAutoTime");
-    cfgAutoTime = getCfgAutoTime() ? getCfgAutoTime() : 30;
+    // Fields are append-only, so whatever the blob has overlays the defaults.
+    LightConfig loaded;
+    memcpy(&loaded, blob + sizeof(header), lightConfigPayload(header));
+    cfg = loaded;
 
-    Serial.println("Loading light configuration - cfgReverseSecondRow");
-    cfgReverseSecondRow = getCfgReverseSecondRow();
-    
-    Serial.println("Loading light configuration - cfgCircularMode");
-    cfgCircularMode = getCfgCircularMode();
+    if (header.version != LIGHT_CONFIG_VERSION || header.size != sizeof(LightConfig))
+    {
+        saveConfig();
+    }
+}
 
-    // Setup goes in here
+/**
+ * Builds the configuration from the one-key-per-setting layout used by older
+ * firmware and stores it as a blob. The old keys are left in place so a
+ * downgrade still finds them.
+ */
+void LightUtils::migrateLegacyConfig(void)
+{
+    cfg.program = PreferencesManager::getInt("cfgProgram", 1);
+    cfg.sin = PreferencesManager::getInt("cfgSin", 0);
+    cfg.brightness = PreferencesManager::getInt("cfgBrightness", 255);
+    cfg.updates = PreferencesManager::getInt("cfgUpdates", 100);
+    if (!cfg.updates)
+    {
+        cfg.updates = 30;
+    }
+    cfg.reverse = PreferencesManager::getBool("cfgReverse", false);
+    cfg.fire = PreferencesManager::getBool("cfgFire", false);
+    cfg.localDisable = PreferencesManager::getBool("cfgLocalDisable", false);
+    cfg.autoLight = PreferencesManager::getBool("cfgAuto", false);
+    cfg.autoTime = PreferencesManager::getInt("cfgAutoTime", 0);
+    if (!cfg.autoTime)
+    {
+        cfg.autoTime = 30;
+    }
+    cfg.reverseSecondRow = PreferencesManager::getBool("cfgReverseSecondRow", false);
+    cfg.circularMode = PreferencesManager::getBool("cfgCircularMode", false);
+
+    saveConfig();
+}
+
+/**
+ * How many bytes of a stored LightConfig to copy over the defaults. Older
+ * versions stop at their last field: the padding after it may be where a
+ * newer field now lives.
+ *
+ * @param header The header stored with the configuration.
+ */
+size_t lightConfigPayload(const LightConfigHeader &header)
+{
+    size_t fields;
+    switch (header.version)
+    {
+    case 1:
+        fields = offsetof(LightConfig, circularMode) + sizeof(bool);
+        break;
+    case 2:
+        fields = offsetof(LightConfig, blendTime) + sizeof(uint16_t);
+        break;
+    case 3:
+        fields = offsetof(LightConfig, circularSpin) + sizeof(int8_t);
+        break;
+    case 4:
+        fields = offsetof(LightConfig, fadeCurve) + sizeof(uint8_t);
+        break;
+    case 5:
+        fields = offsetof(LightConfig, fireColumns) + sizeof(uint8_t);
+        break;
+    case 6:
+        fields = offsetof(LightConfig, text) + LIGHT_TEXT_LENGTH;
+        break;
+    default:
+        fields = sizeof(LightConfig);
+        break;
+    }
+    return min(min((size_t)header.size, fields), sizeof(LightConfig));
+}
+
+/**
+ * Stores the whole configuration as one blob. The preferences journal folds
+ * repeated saves into a single NVS write.
+ */
+void LightUtils::saveConfig(void)
+{
+    uint8_t blob[sizeof(LightConfigHeader) + sizeof(LightConfig)];
+    LightConfigHeader header = {LIGHT_CONFIG_VERSION, sizeof(LightConfig)};
+    LightConfig copy = snapshotConfig();
+
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), &copy, sizeof(copy));
+    PreferencesManager::setBytes(LIGHT_CONFIG_KEY, blob, sizeof(blob));
+}
+
+static uint32_t getConfigParam(const LightConfig &config, LightParam param)
+{
+    switch (param)
+    {
+    case LightParam::Program:
+        return config.program;
+    case LightParam::Sin:
+        return config.sin;
+    case LightParam::Brightness:
+        return config.brightness;
+    case LightParam::Updates:
+        return config.updates;
+    case LightParam::Reverse:
+        return config.reverse;
+    case LightParam::Fire:
+        return config.fire;
+    case LightParam::LocalDisable:
+        return config.localDisable;
+    case LightParam::AutoLight:
+        return config.autoLight;
+    case LightParam::AutoTime:
+        return config.autoTime;
+    case LightParam::ReverseSecondRow:
+        return config.reverseSecondRow;
+    case LightParam::CircularMode:
+        return config.circularMode;
+    case LightParam::BlendTime:
+        return config.blendTime;
+    case LightParam::CircularArms:
+        return config.circularArms;
+    case LightParam::CircularSpin:
+        return (uint8_t)config.circularSpin;
+    case LightParam::FadeTime:
+        return config.fadeTime;
+    case LightParam::FadeCurve:
+        return config.fadeCurve;
+    case LightParam::FireCooling:
+        return config.fireCooling;
+    case LightParam::FireSparking:
+        return config.fireSparking;
+    case LightParam::FireColumns:
+        return config.fireColumns;
+    case LightParam::ParticleCap:
+        return config.particleCap;
+    default:
+        return 0;
+    }
+}
+
+static void setConfigParam(LightConfig &config, LightParam param, uint32_t value)
+{
+    switch (param)
+    {
+    case LightParam::Program:
+        config.program = value;
+        break;
+    case LightParam::Sin:
+        config.sin = value;
+        break;
+    case LightParam::Brightness:
+        config.brightness = value;
+        break;
+    case LightParam::Updates:
+        config.updates = value;
+        break;
+    case LightParam::Reverse:
+        config.reverse = value;
+        break;
+    case LightParam::Fire:
+        config.fire = value;
+        break;
+    case LightParam::LocalDisable:
+        config.localDisable = value;
+        break;
+    case LightParam::AutoLight:
+        config.autoLight = value;
+        break;
+    case LightParam::AutoTime:
+        config.autoTime = value;
+        break;
+    case LightParam::ReverseSecondRow:
+        config.reverseSecondRow = value;
+        break;
+    case LightParam::CircularMode:
+        config.circularMode = value;
+        break;
+    case LightParam::BlendTime:
+        config.blendTime = value;
+        break;
+    case LightParam::CircularArms:
+        config.circularArms = value;
+        break;
+    case LightParam::CircularSpin:
+        config.circularSpin = (int8_t)value;
+        break;
+    case LightParam::FadeTime:
+        config.fadeTime = value;
+        break;
+    case LightParam::FadeCurve:
+        config.fadeCurve = value;
+        break;
+    case LightParam::FireCooling:
+        config.fireCooling = value;
+        break;
+    case LightParam::FireSparking:
+        config.fireSparking = value;
+        break;
+    case LightParam::FireColumns:
+        config.fireColumns = value;
+        break;
+    case LightParam::ParticleCap:
+        config.particleCap = value;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Applies everything the UI and API have queued since the last frame. Only
+ * called from the render task, at the start of a frame.
+ */
+void LightUtils::applyCommands(void)
+{
+    uint32_t values[(uint8_t)LightParam::Count];
+    uint32_t mask = commands.take(values);
+
+    // Strings don't fit in a queue slot, so they're copied from the shared
+    // configuration instead
+    const uint32_t strings = (1 << (uint8_t)LightParam::Effect) | (1 << (uint8_t)LightParam::Text);
+    if (mask & strings)
+    {
+        LightConfig shared = snapshotConfig();
+        memcpy(frameCfg.effect, shared.effect, sizeof(frameCfg.effect));
+        memcpy(frameCfg.text, shared.text, sizeof(frameCfg.text));
+        effectChanged = true;
+    }
+
+    for (uint8_t i = 0; mask; i++, mask >>= 1)
+    {
+        if (mask & 1)
+        {
+            setConfigParam(frameCfg, (LightParam)i, values[i]);
+        }
+    }
+}
+
+/**
+ * Takes a consistent copy of the shared configuration.
+ *
+ * @return A copy of the configuration that can't be torn by a concurrent setter.
+ */
+LightConfig LightUtils::snapshotConfig(void)
+{
+    portENTER_CRITICAL(&cfgMux);
+    LightConfig copy = cfg;
+    portEXIT_CRITICAL(&cfgMux);
+    return copy;
+}
+
+/**
+ * Returns a copy of the whole configuration.
+ */
+LightConfig LightUtils::getConfig(void)
+{
+    return snapshotConfig();
+}
+
+/**
+ * Replaces the whole configuration in one step. Every field is queued in a
+ * single batch so the render task picks them up together at the start of its
+ * next frame, and the change is persisted as a single blob write.
+ *
+ * @param requested The configuration to apply, clamped by sanitizeConfig().
+ */
+void LightUtils::applyConfig(const LightConfig &requested)
+{
+    LightConfig config = requested;
+    sanitizeConfig(config);
+
+    portENTER_CRITICAL(&cfgMux);
+    bool layoutChanged = cfg.reverseSecondRow != config.reverseSecondRow;
+    cfg = config;
+    portEXIT_CRITICAL(&cfgMux);
+
+    uint32_t values[(uint8_t)LightParam::Count];
+    for (uint8_t i = 0; i < (uint8_t)LightParam::Count; i++)
+    {
+        values[i] = getConfigParam(config, (LightParam)i);
+    }
+    commands.postBatch(values);
+
+    saveConfig();
+
+    if (layoutChanged)
+    {
+        rebuildPixelMap();
+    }
 }
 
 /**
  * The loop function of the LightUtils class.
- * This function is called repeatedly in the main loop of the program.
+ * This function is called repeatedly by the render task. Each call waits
+ * for the next frame deadline, renders one frame into a free buffer and
+ * hands it to the output task.
  */
 void LightUtils::loop()
 {
+    // Setters only queue their changes. They're all applied here, so the
+    // whole frame renders from one consistent configuration, and a rate
+    // change paces this very frame.
+    applyCommands();
+
+    // Pace frames off absolute deadlines so render and output time don't
+    // eat into the configured rate.
+    scheduler.setRate(frameCfg.updates);
+    scheduler.waitForFrame();
+
+    // Anything posted while waiting still makes this frame
+    applyCommands();
 
     static uint32_t lastAuto = 0;
 
-    if (cfgAuto)
+    // A rebuilt pixel map is swapped in on a frame boundary too
+    if (pixelMap.apply())
+    {
+        framesToClear = FRAME_BUFFERS;
+    }
+    pixelTable = pixelMap.getTable();
+    mappedLeds = pixelMap.getLength();
+    // Without rows the whole strip is one row, so spans after a segment
+    // stay on it
+    canvasWidth = pixelMap.getWidth() ? pixelMap.getWidth() : mappedLeds;
+
+    applySegments();
+    layers.apply();
+
+    // Blocks only if the output task is still pushing both buffers
+    Frame *frame = pipeline.acquire();
+    leds = frame->leds;
+
+    // Pixels the map leaves out have to go black in every buffer
+    if (framesToClear)
+    {
+        fill_solid(leds, numLeds, CRGB::Black);
+        framesToClear--;
+    }
+
+    // Program changes are picked up here so the palette switches on a frame
+    // boundary, together with the rest of the configuration.
+    if (frameCfg.program != renderedProgram)
+    {
+        renderedProgram = frameCfg.program;
+        selectBasePalette(renderedProgram);
+    }
+
+    if (frameCfg.autoLight)
     {
-        if (millis() - lastAuto > cfgAutoTime * 1000)
+        if (millis() - lastAuto > frameCfg.autoTime * 1000)
         {
             uint32_t randomPalette = random(1, 19);
             /*
@@ -181,184 +690,411 @@ void LightUtils::loop()
             Serial.println(randomPalette);
 
             Serial.print("Next palette change in : ");
-            Serial.println(cfgAutoTime);
+            Serial.println(frameCfg.autoTime);
             */
             lastAuto = millis();
-            getPalette(randomPalette, false);
+            selectBasePalette(randomPalette);
         }
     }
 
-    uint8_t maxChanges = 12;
+    // Only does work while a transition is running
+    basePalette.setDuration(frameCfg.blendTime);
+    basePalette.step(millis());
 
-    nblendPaletteTowardPalette(currentPalette, targetPalette, maxChanges);
+    if (effectChanged)
+    {
+        effectChanged = false;
+        namedEffect = frameCfg.effect[0] ? EffectRegistry::find(frameCfg.effect) : NULL;
+    }
 
-    if (getCfgFire())
+    // Switching effect crossfades from the one that was showing
+    Effect *effect = namedEffect ? namedEffect : selectEffect(frameCfg.fire, frameCfg.circularMode);
+    if (effect != baseEffect)
     {
-        Fire2012WithPalette();
+        fade.setDuration(frameCfg.fadeTime);
+        fade.setCurve((FadeCurve)frameCfg.fadeCurve);
+        fade.start(baseEffect, millis());
+        baseEffect = effect;
+    }
+    fade.step(millis());
+
+    static uint8_t startIndex = 0;
+    startIndex = startIndex + 1; /* motion speed */
+    circularPhase += (uint32_t)(frameCfg.circularSpin * (1 << 20)); // 16 = one palette step per frame
+    renderSegments(startIndex);
+    renderedFrames++;
+
+    // Overlays, including the protected LEDs, go on top of every effect
+    layers.composite(leds);
+
+    frame->brightness = frameCfg.brightness;
+    frame->blank = frameCfg.localDisable;
+    pipeline.submit(frame);
+
+    scheduler.frameDone();
+}
+
+/**
+ * A cheap hash of the pixels, 4 bytes at a time, for spotting frames that
+ * are the same as the last one pushed. The same pass totals each channel for
+ * the power limiter, so the frame is only read once.
+ *
+ * @param hash Running hash, carried from one strip to the next.
+ */
+static uint32_t scanPixels(const CRGB *pixels, uint16_t count, uint32_t hash, ChannelSums &sums)
+{
+    const uint8_t *bytes = (const uint8_t *)pixels;
+
+    // Four pixels are three whole words
+    uint16_t groups = count / 4;
+    for (uint16_t i = 0; i < groups; i++, bytes += 12)
+    {
+        uint32_t w[3];
+        memcpy(w, bytes, 12); // CRGB is byte aligned
+        for (uint8_t j = 0; j < 3; j++)
+        {
+            hash = (hash ^ w[j]) * 16777619u;
+            hash ^= hash >> 15;
+        }
+
+        // Little endian: r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+        sums.r += (w[0] & 0xFF) + (w[0] >> 24) + ((w[1] >> 16) & 0xFF) + ((w[2] >> 8) & 0xFF);
+        sums.g += ((w[0] >> 8) & 0xFF) + (w[1] & 0xFF) + (w[1] >> 24) + ((w[2] >> 16) & 0xFF);
+        sums.b += ((w[0] >> 16) & 0xFF) + ((w[1] >> 8) & 0xFF) + (w[2] & 0xFF) + (w[2] >> 24);
+    }
+    for (uint16_t i = groups * 4; i < count; i++, bytes += 3)
+    {
+        hash = (hash ^ bytes[0]) * 16777619u;
+        hash = (hash ^ bytes[1]) * 16777619u;
+        hash = (hash ^ bytes[2]) * 16777619u;
+        sums.r += bytes[0];
+        sums.g += bytes[1];
+        sums.b += bytes[2];
+    }
+    return hash;
+}
+
+/**
+ * Pushes rendered frames to the strip. Runs on its own task, pinned to the
+ * other core, so clocking out one frame overlaps rendering the next.
+ */
+void LightUtils::outputLoop()
+{
+    Frame *frame = pipeline.next();
+    uint32_t start = micros();
+
+    // Static programs and local disable produce the same frame over and over.
+    // Those only go out again as a keep-alive.
+    uint8_t brightness = frame->blank ? 0 : frame->brightness;
+
+    // Each strip's brightness after the power limiter. The limited values go
+    // into the hash so a strip that's still recovering keeps being pushed.
+    uint8_t stripBrightness[MAX_STRIPS] = {0};
+    uint32_t hash = 2166136261u;
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < MAX_STRIPS; i++)
+    {
+        ChannelSums sums;
+        if (brightness)
+        {
+            hash = scanPixels(frame->leds + offset, layout.leds[i], hash, sums);
+        }
+        stripBrightness[i] = power.update(i, sums, layout.leds[i], brightness);
+        hash = (hash ^ stripBrightness[i]) * 16777619u;
+        offset += layout.leds[i];
+    }
+    if (!brightness)
+    {
+        hash = 0;
+    }
+    uint32_t now = millis();
+#if APA102_USE_SPI_DMA
+    // A dithered strip changes every frame even when the pixels don't
+    bool mustPush = output.isDithering();
+#else
+    bool mustPush = false;
+#endif
+    if (!mustPush && pushedOnce && hash == lastPushHash && now - lastPushMs < FRAME_KEEPALIVE_MS)
+    {
+        pipeline.recordSkip(micros() - start);
+        pipeline.release(frame);
+        return;
+    }
+    lastPushHash = hash;
+    lastPushMs = now;
+    pushedOnce = true;
+
+#if APA102_USE_SPI_DMA
+    // Encodes into the drivers' own DMA buffers and returns. The SPI
+    // peripherals clock every strip out in parallel while this buffer goes
+    // back to the render task.
+    uint8_t outputBrightness[MAX_STRIPS];
+    for (uint8_t i = 0; i < MAX_STRIPS; i++)
+    {
+        uint8_t index = outputIndex(i);
+        if (index != NO_OUTPUT)
+        {
+            outputBrightness[index] = stripBrightness[i];
+        }
+    }
+    output.show(frame->leds, outputBrightness);
+#else
+    // FastLED pushes the strips one after another
+    if (ledController)
+    {
+        ledController->setLeds(frame->leds, layout.leds[0]);
+    }
+    if (ledController2)
+    {
+        ledController2->setLeds(frame->leds + layout.leds[0], layout.leds[1]);
+    }
+    if (!frame->blank)
+    {
+        // FastLED has one brightness for every strip, so the tightest budget wins
+        FastLED.show(min(stripBrightness[0], stripBrightness[1]));
     }
     else
     {
-        static uint8_t startIndex = 0;
-        startIndex = startIndex + 1; /* motion speed */
-        FillLEDsFromPaletteColors(startIndex);
+        FastLED.showColor(CRGB::Black);
     }
+#endif
 
-    FastLED.setBrightness(getCfgBrightness());
+    pipeline.recordOutput(micros() - start);
+    pipeline.release(frame);
+}
 
-    if (!getCfgLocalDisable())
+/**
+ * Renders logical pixels that no segment covers with the main configuration.
+ * With no segments this is the whole strip.
+ */
+void LightUtils::renderBase(uint16_t first, uint16_t count, uint8_t startIndex)
+{
+    EffectSettings settings;
+    // Carry on the pattern as if the gap were part of the whole strip
+    settings.colorIndex = startIndex + first * 3;
+    settings.sin = frameCfg.sin;
+    settings.reverse = frameCfg.reverse;
+    settings.arms = frameCfg.circularArms;
+    // The old circular mode turned the ring by the color index too, gap
+    // offset included
+    settings.phase = circularPhase + ((uint32_t)(uint8_t)(first * 3) << 24);
+    settings.cooling = frameCfg.fireCooling;
+    settings.sparking = frameCfg.fireSparking;
+    settings.columns = frameCfg.fireColumns;
+    settings.frame = renderedFrames;
+    settings.text = frameCfg.text;
+    settings.extent = mappedLeds;
+    settings.particles = frameCfg.particleCap;
+
+    if (!fade.isActive())
     {
-        FastLED.show();
-        // FastLED.delay(1000 / cfgUpdates); // Enables temporal dithering
-        delay(1000 / cfgUpdates);
+        renderSpan(baseEffect, leds, first, count, basePalette, baseLut, settings);
+        return;
+    }
+
+    // The outgoing effect keeps its own palette table so the two don't
+    // rebuild one between them every frame
+    renderSpan(fade.getOutgoing(), fade.getOutgoingBuffer(), first, count, basePalette, fadeLut, settings);
+    renderSpan(baseEffect, fade.getIncomingBuffer(), first, count, basePalette, baseLut, settings);
+    fade.mix(leds, pixelTable + first, count);
+}
+
+/**
+ * Maps the configuration flags onto a registered effect.
+ */
+Effect *LightUtils::selectEffect(bool fire, bool circular)
+{
+    if (fire)
+    {
+        return fireEffect;
+    }
+    return circular ? circularEffect : paletteEffect;
+}
+
+/**
+ * Renders one run of logical pixels with an effect, bringing its expanded
+ * palette up to date first.
+ *
+ * @param buffer Where to render, the frame or one of the crossfade buffers.
+ * @param lut The expanded palette kept for whatever owns this span.
+ */
+void LightUtils::renderSpan(Effect *effect, CRGB *buffer, uint16_t first, uint16_t count, const PaletteBlend &palette, PaletteLut &lut, const EffectSettings &settings)
+{
+    if (!effect || !count)
+    {
+        return;
+    }
+
+    if (effect->usesTargetPalette())
+    {
+        lut.update(palette.getTarget(), palette.getTargetVersion(), 255);
     }
     else
     {
-        // TODO: Set the output to all black before disabling
-        FastLED.clear(true);
-        delay(1000 / cfgUpdates);
-    }
-}
-
-/**
- * Maps LED index based on strip configuration
- */
-uint16_t LightUtils::mapLedIndex(uint16_t index) {
-    if (!cfgReverseSecondRow) return index;
-    
-    // For a two-row setup where both rows start from right
-    // First 12 LEDs (indices 0-11) are the first row
-    // Next 18 LEDs (indices 12-29) are the second row
-    if (index < 12) {
-        return index; // first row stays as is
-    } else {
-        // Calculate the position within the second row (0 to 17)
-        uint16_t secondRowPosition = index - 12;
-        // Reverse the position within the second row (17 to 0)
-        uint16_t reversedPosition = (NUM_LEDS - 12 - 1) - secondRowPosition;
-        // Map back to the full LED strip index (12 to 29)
-        return 12 + reversedPosition;
-    }
-}
-
-/**
- * Fills the LED strip with colors from the current palette starting at the given color index.
- *
- * @param colorIndex The starting index in the current palette.
- */
-void LightUtils::FillLEDsFromPaletteColors(uint8_t colorIndex)
-{
-    uint8_t brightness = getCfgBrightness();
-    if (cfgCircularMode) {
-        // Special handling for circular mode - imagine the LEDs are in a circle
-        // We use sin/cos to create a circular effect instead of linear
-        float angleStep = (2 * PI) / NUM_LEDS;
-        float offset = colorIndex * 0.1; // Controls speed of rotation
-        
-        for (int i = 0; i < NUM_LEDS; i++) {
-            uint16_t mappedIndex = mapLedIndex(i);
-            
-            // Skip this LED if it's protected
-            if (protectedLeds[mappedIndex]) continue;
-            
-            // Calculate position in the circle
-            float angle = i * angleStep + offset;
-            
-            // Use sine wave to create circular pattern
-            uint8_t waveSin = sin8(i * 256 / NUM_LEDS + colorIndex);
-            uint8_t waveCos = sin8(i * 256 / NUM_LEDS + colorIndex + 64); // offset by 90 degrees
-            
-            // Combine for a more interesting pattern
-            uint8_t waveIndex = cfgSin == 0 ? colorIndex : colorIndex + (waveSin * cfgSin / 16);
-            
-            // Apply direction based on reverse setting
-            if (cfgReverse) {
-                waveIndex = colorIndex + (waveCos * cfgSin / 16);
-            }
-            
-            leds[mappedIndex] = ColorFromPalette(currentPalette, waveIndex, brightness);
-        }
-    } else {
-        // Original linear pattern code
-        if (!getCfgReverse())
+        lut.update(palette.getCurrent(), palette.getVersion(), frameCfg.brightness);
+    }
+
+    EffectTarget target = {buffer, pixelTable + first, heat + first, count, &lut, canvasWidth, first};
+    effect->render(target, settings);
+}
+
+/**
+ * Renders the frame in one pass from the first logical pixel to the last:
+ * each segment into its own slice, and the main configuration into the gaps
+ * between them. Every pixel is rendered exactly once.
+ */
+void LightUtils::renderSegments(uint8_t startIndex)
+{
+    uint16_t pos = 0;
+    for (uint8_t s = 0; s < frameSegmentCount; s++)
+    {
+        const SegmentConfig &segment = frameSegments[s];
+        SegmentState &state = segmentStates[s];
+
+        uint16_t first = min(segment.start, mappedLeds);
+        uint16_t end = min((uint32_t)segment.start + segment.length, (uint32_t)mappedLeds);
+        if (first > pos)
         {
-            for (int i = 0; i < NUM_LEDS; i++)
-            {
-                uint16_t mappedIndex = mapLedIndex(i);
-                
-                // Skip this LED if it's protected
-                if (protectedLeds[mappedIndex]) continue;
-                
-                if (cfgSin == 0)
-                {
-                    leds[mappedIndex] = ColorFromPalette(currentPalette, colorIndex, brightness);
-                    colorIndex += 3;
-                }
-                else
-                {
-                    leds[mappedIndex] = ColorFromPalette(currentPalette, colorIndex + sin8(i * cfgSin), brightness);
-                    colorIndex += 3;
-                }
-            }
+            renderBase(pos, first - pos, startIndex);
         }
-        else
+
+        state.palette.setDuration(frameCfg.blendTime);
+        state.palette.step(millis());
+        state.startIndex += segment.speed;
+
+        if (end > first)
         {
-            for (int i = NUM_LEDS - 1; i >= 0; i--)
-            {
-                uint16_t mappedIndex = mapLedIndex(i);
-                
-                // Skip this LED if it's protected
-                if (protectedLeds[mappedIndex]) continue;
-                
-                if (cfgSin == 0)
-                {
-                    leds[mappedIndex] = ColorFromPalette(currentPalette, colorIndex, brightness);
-                    colorIndex += 3;
-                }
-                else
-                {
-                    leds[mappedIndex] = ColorFromPalette(currentPalette, colorIndex + sin8((NUM_LEDS - 1 - i) * cfgSin), brightness);
-                    colorIndex += 3;
-                }
-            }
+            EffectSettings settings;
+            settings.colorIndex = state.startIndex;
+            settings.sin = segment.sin;
+            settings.reverse = segment.reverse;
+            settings.arms = frameCfg.circularArms;
+            settings.phase = circularPhase;
+            settings.cooling = segment.cooling;
+            settings.sparking = segment.sparking;
+            settings.columns = segment.columns;
+            settings.frame = renderedFrames;
+            settings.text = frameCfg.text;
+            settings.extent = mappedLeds;
+            settings.particles = frameCfg.particleCap;
+
+            renderSpan(state.effect, leds, first, end - first, state.palette, segmentLuts[s], settings);
         }
+        pos = max(pos, end);
+    }
+
+    if (pos < mappedLeds)
+    {
+        renderBase(pos, mappedLeds - pos, startIndex);
     }
 }
 
-CRGBPalette16 LightUtils::getPalette(uint32_t paletteSelect, bool saveSelection)
+/**
+ * Picks up segment changes at the start of a frame. Segments that are still
+ * there keep their palette blend and position, so editing one doesn't
+ * restart the others. Effect names are looked up here rather than every
+ * frame; a segment without one, or with one that's no longer registered,
+ * goes by its fire flag.
+ */
+void LightUtils::applySegments(void)
 {
+    uint8_t count;
+    if (!segments.take(spareSegments, count))
+    {
+        return;
+    }
 
-    cfgProgram = paletteSelect;
-
-    if (saveSelection)
+    for (uint8_t i = 0; i < count; i++)
     {
-        PreferencesManager::setInt("cfgProgram", paletteSelect);
+        const SegmentConfig &segment = spareSegments[i];
+        SegmentState &state = spareStates[i];
+
+        int8_t previous = -1;
+        for (uint8_t j = 0; j < frameSegmentCount; j++)
+        {
+            if (strcmp(frameSegments[j].name, segment.name) == 0)
+            {
+                previous = j;
+                break;
+            }
+        }
+
+        if (previous >= 0)
+        {
+            state = segmentStates[previous];
+            if (state.program != segment.program)
+            {
+                state.program = segment.program;
+                CRGBPalette16 palette = state.palette.getTarget();
+                selectPalette(segment.program, palette);
+                state.palette.setTarget(palette, millis());
+            }
+        }
+        else
+        {
+            state.program = segment.program;
+            state.startIndex = 0;
+            CRGBPalette16 palette(CRGB::Black);
+            selectPalette(segment.program, palette);
+            state.palette.reset(palette);
+        }
+
+        state.effect = segment.effect[0] ? EffectRegistry::find(segment.effect) : NULL;
+        if (!state.effect)
+        {
+            state.effect = selectEffect(segment.fire, false);
+        }
     }
-    else
+
+    for (uint8_t i = 0; i < count; i++)
     {
-        //Serial.println("Not saving palette selection");
+        frameSegments[i] = spareSegments[i];
+        segmentStates[i] = spareStates[i];
+        segmentLuts[i].invalidate(); // Segments may have moved to another index
     }
+    frameSegmentCount = count;
+}
+
+/**
+ * Starts the main configuration's palette blending towards a program's palette.
+ */
+void LightUtils::selectBasePalette(uint32_t paletteSelect)
+{
+    CRGBPalette16 palette = basePalette.getTarget();
+    selectPalette(paletteSelect, palette);
+    basePalette.setTarget(palette, millis());
+}
 
+/**
+ * Fills palette with the palette for a program number. Unknown numbers leave
+ * it unchanged.
+ *
+ * @param paletteSelect The program, as LightConfig::program.
+ * @param palette The palette to fill.
+ */
+void LightUtils::selectPalette(uint32_t paletteSelect, CRGBPalette16 &palette)
+{
     switch (paletteSelect)
     {
     case 1:
-        targetPalette = RainbowColors_p;
+        palette = RainbowColors_p;
         break;
 
     case 2:
-        targetPalette = RainbowStripeColors_p;
+        palette = RainbowStripeColors_p;
         break;
 
     case 3:
-        targetPalette = CloudColors_p;
+        palette = CloudColors_p;
         break;
 
     case 4:
-        targetPalette = PartyColors_p;
+        palette = PartyColors_p;
         break;
 
     case 5:
         // myRedWhiteBluePalette_p
-        targetPalette = CRGBPalette16(
+        palette = CRGBPalette16(
             CRGB::Red,
             CRGB::Gray, // 'white' is too bright compared to red and blue
             CRGB::Blue,
@@ -383,7 +1119,7 @@ CRGBPalette16 LightUtils::getPalette(uint32_t paletteSelect, bool saveSelection)
         // Random Palette
         for (int i = 0; i < 16; i++)
         {
-            targetPalette[i] = CHSV(random8(), 255, random8());
+            palette[i] = CHSV(random8(), 255, random8());
         }
         break;
 
@@ -391,373 +1127,602 @@ CRGBPalette16 LightUtils::getPalette(uint32_t paletteSelect, bool saveSelection)
         // Black and White Stripped
 
         // 'black out' all 16 palette entries...
-        fill_solid(targetPalette, 16, CRGB::Black);
+        fill_solid(palette, 16, CRGB::Black);
         // and set every fourth one to white.
-        targetPalette[0] = CRGB::White;
-        targetPalette[4] = CRGB::White;
-        targetPalette[8] = CRGB::White;
-        targetPalette[12] = CRGB::White;
+        palette[0] = CRGB::White;
+        palette[4] = CRGB::White;
+        palette[8] = CRGB::White;
+        palette[12] = CRGB::White;
 
         break;
 
     case 8:
 
-        targetPalette = quagga_gp;
+        palette = quagga_gp;
         break;
 
     case 9:
 
-        targetPalette = purplefly_gp;
+        palette = purplefly_gp;
         break;
 
     case 10:
 
-        targetPalette = butterflytalker_gp;
+        palette = butterflytalker_gp;
         break;
 
     case 11:
 
-        targetPalette = carousel_gp;
+        palette = carousel_gp;
         break;
 
     case 12:
 
-        targetPalette = autumnrose_gp;
+        palette = autumnrose_gp;
         break;
 
     case 13:
 
-        targetPalette = bhw1_33_gp;
+        palette = bhw1_33_gp;
         break;
 
     case 14:
 
-        targetPalette = bhw1_22_gp;
+        palette = bhw1_22_gp;
         break;
 
     case 15:
 
-        targetPalette = heatmap_gp;
+        palette = heatmap_gp;
         break;
 
     case 16:
 
-        targetPalette = HeatColors_p;
+        palette = HeatColors_p;
         break;
 
     case 17:
 
-        targetPalette = LavaColors_p;
+        palette = LavaColors_p;
         break;
 
     case 18:
 
-        targetPalette = OceanColors_p;
+        palette = OceanColors_p;
         break;
 
     case 19:
 
-        targetPalette = ForestColors_p;
+        palette = ForestColors_p;
         break;
 
     case 20:
 
-        fill_solid(targetPalette, 16, CRGB::White);
+        fill_solid(palette, 16, CRGB::White);
 
         break;
 
     case 21:
 
-        fill_solid(targetPalette, 16, CRGB::Red);
+        fill_solid(palette, 16, CRGB::Red);
 
         break;
 
     case 22:
 
-        fill_solid(targetPalette, 16, CRGB::Green);
+        fill_solid(palette, 16, CRGB::Green);
 
         break;
 
     case 23:
 
-        fill_solid(targetPalette, 16, CRGB::Blue);
+        fill_solid(palette, 16, CRGB::Blue);
 
         break;
 
     case 24:
 
-        fill_solid(targetPalette, 16, CRGB::Purple);
+        fill_solid(palette, 16, CRGB::Purple);
 
         break;
 
     case 25:
 
-        fill_solid(targetPalette, 16, CRGB::Cyan);
+        fill_solid(palette, 16, CRGB::Cyan);
 
         break;
 
     case 26:
 
-        fill_solid(targetPalette, 16, CRGB::Yellow);
+        fill_solid(palette, 16, CRGB::Yellow);
 
         break;
 
     case 50:
 
-        targetPalette = white_dot;
+        palette = white_dot;
         break;
 
     default:
         break;
     }
 
-    return targetPalette;
 }
 
 void LightUtils::setCfgCircularMode(bool circularMode)
 {
-    cfgCircularMode = circularMode;
-    PreferencesManager::setBool("cfgCircularMode", circularMode);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.circularMode = circularMode;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::CircularMode, circularMode);
+    saveConfig();
 }
 
 bool LightUtils::getCfgCircularMode(void)
 {
-    return PreferencesManager::getBool("cfgCircularMode", false);
+    return snapshotConfig().circularMode;
 }
 
-void LightUtils::Fire2012WithPalette(void)
+/**
+ * Sets how long palette changes take to blend in and saves the configuration.
+ *
+ * @param blendTime The transition time in ms. 0 switches palettes instantly.
+ */
+void LightUtils::setCfgBlendTime(uint16_t blendTime)
 {
-    // Array of temperature readings at each simulation cell
-    static uint8_t heat[NUM_LEDS];
-    // Step 1.  Cool down every cell a little
-    for (int i = 0; i < NUM_LEDS; i++)
-    {
-        heat[i] = qsub8(heat[i], random8(0, ((COOLING * 10) / NUM_LEDS) + 2));
-    }
+    portENTER_CRITICAL(&cfgMux);
+    cfg.blendTime = blendTime;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::BlendTime, blendTime);
+    saveConfig();
+}
 
-    // Step 2.  Heat from each cell drifts 'up' and diffuses a little
-    for (int k = NUM_LEDS - 1; k >= 2; k--)
-    {
-        heat[k] = (heat[k - 1] + heat[k - 2] + heat[k - 2]) / 3;
-    }
+uint16_t LightUtils::getCfgBlendTime(void)
+{
+    return snapshotConfig().blendTime;
+}
 
-    // Step 3.  Randomly ignite new 'sparks' of heat near the bottom
-    if (random8() < SPARKING)
+/**
+ * Sets how many times the circular pattern repeats around the ring and saves
+ * the configuration.
+ *
+ * @param arms The number of arms, at least 1.
+ */
+void LightUtils::setCfgCircularArms(uint8_t arms)
+{
+    arms = max(arms, (uint8_t)1);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.circularArms = arms;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::CircularArms, arms);
+    saveConfig();
+}
+
+uint8_t LightUtils::getCfgCircularArms(void)
+{
+    return snapshotConfig().circularArms;
+}
+
+/**
+ * Sets how fast circular mode rotates and saves the configuration.
+ *
+ * @param spin Rotation per frame in 1/16ths of a palette step. 16 matches the
+ *             original circular mode, negative values spin the other way.
+ */
+void LightUtils::setCfgCircularSpin(int8_t spin)
+{
+    portENTER_CRITICAL(&cfgMux);
+    cfg.circularSpin = spin;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::CircularSpin, (uint8_t)spin);
+    saveConfig();
+}
+
+int8_t LightUtils::getCfgCircularSpin(void)
+{
+    return snapshotConfig().circularSpin;
+}
+
+/**
+ * Sets how long switching effects takes to crossfade and saves the
+ * configuration.
+ *
+ * @param fadeTime The transition time in ms. 0 cuts straight over.
+ */
+void LightUtils::setCfgFadeTime(uint16_t fadeTime)
+{
+    portENTER_CRITICAL(&cfgMux);
+    cfg.fadeTime = fadeTime;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::FadeTime, fadeTime);
+    saveConfig();
+}
+
+uint16_t LightUtils::getCfgFadeTime(void)
+{
+    return snapshotConfig().fadeTime;
+}
+
+/**
+ * Sets the shape of effect crossfades and saves the configuration.
+ */
+void LightUtils::setCfgFadeCurve(FadeCurve curve)
+{
+    if (curve >= FadeCurve::Count)
     {
-        int y = random8(7);
-        heat[y] = qadd8(heat[y], random8(160, 255));
+        return;
     }
+    portENTER_CRITICAL(&cfgMux);
+    cfg.fadeCurve = (uint8_t)curve;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::FadeCurve, (uint8_t)curve);
+    saveConfig();
+}
+
+FadeCurve LightUtils::getCfgFadeCurve(void)
+{
+    return (FadeCurve)snapshotConfig().fadeCurve;
+}
+
+/**
+ * Sets the fire simulation for the main configuration and saves it.
+ *
+ * @param cooling How much the air cools as it rises, see DEFAULT_COOLING.
+ * @param sparking Chance out of 255 of a new spark, see DEFAULT_SPARKING.
+ * @param columns Independent flames along the strip, at least 1.
+ */
+void LightUtils::setCfgFire(uint8_t cooling, uint8_t sparking, uint8_t columns)
+{
+    columns = max(columns, (uint8_t)1);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.fireCooling = cooling;
+    cfg.fireSparking = sparking;
+    cfg.fireColumns = columns;
+    portEXIT_CRITICAL(&cfgMux);
+
+    // One batch, so no frame renders with only part of the change
+    uint32_t values[(uint8_t)LightParam::Count];
+    values[(uint8_t)LightParam::FireCooling] = cooling;
+    values[(uint8_t)LightParam::FireSparking] = sparking;
+    values[(uint8_t)LightParam::FireColumns] = columns;
+    commands.postBatch((1UL << (uint8_t)LightParam::FireCooling) | (1UL << (uint8_t)LightParam::FireSparking) |
+                           (1UL << (uint8_t)LightParam::FireColumns),
+                       values);
+    saveConfig();
+}
+
+uint8_t LightUtils::getCfgFireCooling(void)
+{
+    return snapshotConfig().fireCooling;
+}
+
+uint8_t LightUtils::getCfgFireSparking(void)
+{
+    return snapshotConfig().fireSparking;
+}
+
+uint8_t LightUtils::getCfgFireColumns(void)
+{
+    return snapshotConfig().fireColumns;
+}
 
-    // Step 4.  Map from heat cells to LED colors
-    for (int j = 0; j < NUM_LEDS; j++)
+/**
+ * Picks the main effect by name and saves the configuration.
+ *
+ * @param name A registered effect, eg: "plasma", or "" to go back to the fire
+ *             and circular flags.
+ * @return false if there's no effect with that name.
+ */
+bool LightUtils::setCfgEffect(const char *name)
+{
+    if (name[0] && !EffectRegistry::find(name))
     {
-        // Scale the heat value from 0-255 down to 0-240
-        // for best results with color palettes.
-        uint8_t colorindex = scale8(heat[j], 240);
-        CRGB color = ColorFromPalette(targetPalette, colorindex);
-        int pixelnumber;
-        if (cfgReverse)
-        {
-            pixelnumber = (NUM_LEDS - 1) - j;
-        }
-        else
-        {
-            pixelnumber = j;
-        }
-        
-        uint16_t mappedIndex = mapLedIndex(pixelnumber);
-        
-        // Skip this LED if it's protected
-        if (!protectedLeds[mappedIndex]) {
-            leds[mappedIndex] = color;
-        }
+        return false;
     }
+    portENTER_CRITICAL(&cfgMux);
+    strlcpy(cfg.effect, name, sizeof(cfg.effect));
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Effect, 0);
+    saveConfig();
+    return true;
+}
+
+String LightUtils::getCfgEffect(void)
+{
+    return String(snapshotConfig().effect);
 }
 
 /**
- * Sets the brightness of the LED strip and saves the value to the configuration file.
+ * Sets what the text effect scrolls and saves the configuration. Longer text
+ * is cut to LIGHT_TEXT_LENGTH - 1 characters.
+ */
+void LightUtils::setCfgText(const char *text)
+{
+    portENTER_CRITICAL(&cfgMux);
+    strlcpy(cfg.text, text, sizeof(cfg.text));
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Text, 0);
+    saveConfig();
+}
+
+String LightUtils::getCfgText(void)
+{
+    return String(snapshotConfig().text);
+}
+
+/**
+ * Sets how many particles the particle effects may have alive at once and
+ * saves the configuration. Their update and drawing cost grows with this.
+ *
+ * @param cap 1 to MAX_PARTICLES, clamped.
+ */
+void LightUtils::setCfgParticleCap(uint8_t cap)
+{
+    cap = constrain(cap, (uint8_t)1, (uint8_t)MAX_PARTICLES);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.particleCap = cap;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::ParticleCap, cap);
+    saveConfig();
+}
+
+uint8_t LightUtils::getCfgParticleCap(void)
+{
+    return snapshotConfig().particleCap;
+}
+
+/**
+ * Returns how far the main palette transition has got, 0 to 255. Read
+ * without locking, so it's only for reporting.
+ */
+uint8_t LightUtils::getBlendProgress(void)
+{
+    return basePalette.getProgress();
+}
+
+/**
+ * Sets the brightness of the LED strip and saves the configuration.
  *
  * @param brightness The brightness value to set.
  */
 void LightUtils::setCfgBrightness(uint8_t brightness)
 {
     //Serial.println("set brightness");
-    cfgBrightness = brightness;
-    PreferencesManager::setInt("cfgBrightness", brightness);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.brightness = brightness;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Brightness, brightness);
+    saveConfig();
 }
 
 /**
- * Sets the number of updates per second for the LED strip and saves the value to the configuration file.
+ * Sets the number of updates per second for the LED strip and saves the configuration.
  *
  * @param updates The number of updates per second to set.
  */
 void LightUtils::setCfgUpdates(uint16_t updates)
 {
-    cfgUpdates = updates;
-    PreferencesManager::setInt("cfgUpdates", updates);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.updates = updates;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Updates, updates);
+    saveConfig();
 }
 
 void LightUtils::setCfgAutoTime(uint32_t autoTime)
 {
-    cfgAutoTime = autoTime;
-    PreferencesManager::setInt("cfgAutoTime", autoTime);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.autoTime = autoTime;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::AutoTime, autoTime);
+    saveConfig();
 }
 
 /**
- * Sets the sine value for the LED strip and saves the value to the configuration file.
+ * Sets the sine value for the LED strip and saves the configuration.
  *
  * @param sin The sine value to set.
  */
 void LightUtils::setCfgSin(uint8_t sin)
 {
-    cfgSin = sin;
-    PreferencesManager::setInt("cfgSin", sin);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.sin = sin;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Sin, sin);
+    saveConfig();
 }
 
 /**
- * Sets the current LED program based on the given program index and retrieves the corresponding color palette.
+ * Sets the current LED program and saves the configuration. The render task
+ * selects the matching palette at the start of its next frame.
  *
  * @param program The index of the LED program to set.
  */
 void LightUtils::setCfgProgram(uint8_t program)
 {
-    getPalette(program, true);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.program = program;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Program, program);
+    saveConfig();
 }
 
 /**
- * Sets the reverse flag for the LED strip and saves the value to the configuration file.
+ * Sets the reverse flag for the LED strip and saves the configuration.
  *
  * @param reverse The reverse flag value to set.
  */
 void LightUtils::setCfgReverse(bool reverse)
 {
-    cfgReverse = reverse;
-    PreferencesManager::setBool("cfgReverse", reverse);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.reverse = reverse;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Reverse, reverse);
+    saveConfig();
 }
 
 void LightUtils::setCfgReverseSecondRow(bool reverse) {
-    cfgReverseSecondRow = reverse;
-    PreferencesManager::setBool("cfgReverseSecondRow", reverse);
+    portENTER_CRITICAL(&cfgMux);
+    bool changed = cfg.reverseSecondRow != reverse;
+    cfg.reverseSecondRow = reverse;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::ReverseSecondRow, reverse);
+    saveConfig();
+
+    // The two-row layout is baked into the pixel map
+    if (changed)
+    {
+        rebuildPixelMap();
+    }
 }
 
 bool LightUtils::getCfgReverseSecondRow(void) {
-    return PreferencesManager::getBool("cfgReverseSecondRow", false);
+    return snapshotConfig().reverseSecondRow;
 }
 
 void LightUtils::setCfgAuto(bool autoLight)
 {
-    cfgAuto = autoLight;
-    PreferencesManager::setBool("cfgAuto", autoLight);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.autoLight = autoLight;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::AutoLight, autoLight);
+    saveConfig();
 }
 
 /**
- * Sets the fire flag for the LED strip and saves the value to the configuration file.
+ * Sets the fire flag for the LED strip and saves the configuration.
  *
  * @param fire The fire flag value to set.
  */
 void LightUtils::setCfgFire(bool fire)
 {
-    cfgFire = fire;
-    PreferencesManager::setBool("cfgFire", fire);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.fire = fire;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::Fire, fire);
+    saveConfig();
 }
 
 /**
- * Sets the local disable flag for the LED strip and saves the value to the configuration file.
+ * Sets the local disable flag for the LED strip and saves the configuration.
  *
  * @param localDisable The local disable flag value to set.
  */
 void LightUtils::setCfgLocalDisable(bool localDisable)
 {
-    cfgLocalDisable = localDisable;
-    PreferencesManager::setBool("cfgLocalDisable", localDisable);
+    portENTER_CRITICAL(&cfgMux);
+    cfg.localDisable = localDisable;
+    portEXIT_CRITICAL(&cfgMux);
+    commands.post(LightParam::LocalDisable, localDisable);
+    saveConfig();
 }
 
 /**
- * Retrieves the brightness value from the configuration file.
+ * Retrieves the brightness value from the in-RAM configuration.
  *
  * @return The brightness value.
  */
 uint8_t LightUtils::getCfgBrightness(void)
 {
-    //Serial.println("getCfgBrightness called");
-    uint8_t brightness = PreferencesManager::getInt("cfgBrightness", 255);
-    //Serial.print("Preference value for cfgBrightness: ");
-    //Serial.println(brightness);
-    return brightness;
+    return snapshotConfig().brightness;
 }
 
 /**
- * Retrieves the number of updates from the configuration file.
+ * Retrieves the number of updates from the in-RAM configuration.
  *
  * @return The number of updates.
  */
 uint16_t LightUtils::getCfgUpdates(void)
 {
-    return PreferencesManager::getInt("cfgUpdates", 100);
+    return snapshotConfig().updates;
 }
 
 /**
- * Retrieves the sine value from the configuration file.
+ * Retrieves the sine value from the in-RAM configuration.
  *
  * @return The sine value.
  */
 uint8_t LightUtils::getCfgSin(void)
 {
-    return PreferencesManager::getInt("cfgSin", 0);
+    return snapshotConfig().sin;
 }
 
 /**
- * Retrieves the LED program index from the configuration file.
+ * Retrieves the LED program index from the in-RAM configuration.
  *
  * @return The LED program index.
  */
 uint8_t LightUtils::getCfgProgram(void)
 {
-    return PreferencesManager::getInt("cfgProgram", 1);
+    return snapshotConfig().program;
 }
 
 uint32_t LightUtils::getCfgAutoTime(void)
 {
-    return PreferencesManager::getInt("cfgAutoTime", 0);
+    return snapshotConfig().autoTime;
 }
 
 /**
- * Retrieves the reverse flag from the configuration file.
+ * Retrieves the reverse flag from the in-RAM configuration.
  *
  * @return The reverse flag value.
  */
 bool LightUtils::getCfgReverse(void)
 {
-    return PreferencesManager::getBool("cfgReverse", false);
+    return snapshotConfig().reverse;
 }
 
 bool LightUtils::getCfgAuto(void)
 {
-    return PreferencesManager::getBool("cfgAuto", false);
+    return snapshotConfig().autoLight;
 }
 
 /**
- * Retrieves the fire flag from the configuration file.
+ * Retrieves the fire flag from the in-RAM configuration.
  *
  * @return The fire flag value.
  */
 bool LightUtils::getCfgFire(void)
 {
-    return PreferencesManager::getBool("cfgFire", false);
+    return snapshotConfig().fire;
 }
 
 /**
- * Retrieves the local disable flag from the configuration file.
+ * Retrieves the local disable flag from the in-RAM configuration.
  *
  * @return The local disable flag value.
  */
 bool LightUtils::getCfgLocalDisable(void)
 {
-    return PreferencesManager::getBool("cfgLocalDisable", false);
+    return snapshotConfig().localDisable;
+}
+
+/**
+ * Returns the queue the setters use to hand changes to the render task.
+ */
+LightCommandQueue &LightUtils::getCommandQueue(void)
+{
+    return commands;
+}
+
+/**
+ * Returns the frame pacing statistics of the render task.
+ */
+FrameScheduler::FrameStats LightUtils::getFrameStats(void)
+{
+    return scheduler.getStats();
+}
+
+/**
+ * Returns the render/output frame pipeline.
+ */
+FramePipeline &LightUtils::getPipeline(void)
+{
+    return pipeline;
 }
 
 /**
- * Returns a pointer to the array of CRGB objects representing the LED strip.
+ * Returns a pointer to the frame buffer most recently used by the render task.
  *
  * @return A pointer to the array of CRGB objects representing the LED strip.
  */
@@ -775,47 +1740,132 @@ CRGB *LightUtils::getLeds(void)
 uint16_t LightUtils::getNumberOfLeds(void)
 {
 
-    return NUM_LEDS;
+    return numLeds;
 }
 
+/**
+ * Returns the strip layout the LED buffers were sized from.
+ */
+const StripLayout &LightUtils::getStripLayout(void)
+{
+    return layout;
+}
+
+#if APA102_USE_SPI_DMA
+/**
+ * The output only has the strips that came up, in slot order.
+ *
+ * @return NO_OUTPUT if the slot isn't fitted or its SPI host failed.
+ */
+uint8_t LightUtils::outputIndex(uint8_t strip)
+{
+    return strip < MAX_STRIPS ? stripOutput[strip] : NO_OUTPUT;
+}
+#endif
+
+/**
+ * Bits of temporal dithering a strip currently gets, 0 when it isn't dithering.
+ */
+uint8_t LightUtils::getDitherBits(uint8_t strip)
+{
+#if APA102_USE_SPI_DMA
+    uint8_t index = outputIndex(strip);
+    if (index != NO_OUTPUT)
+    {
+        return output.getDitherBits(index);
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Returns the memory used for one strip slot: its share of the LED arena
+ * plus the output driver's DMA buffers.
+ *
+ * @param strip The strip slot, 0 to MAX_STRIPS - 1.
+ */
+size_t LightUtils::getStripMemory(uint8_t strip)
+{
+    if (strip >= MAX_STRIPS || !layout.leds[strip])
+    {
+        return 0;
+    }
+
+    size_t bytes = ledArenaBytes(layout.leds[strip]);
+#if APA102_USE_SPI_DMA
+    uint8_t index = outputIndex(strip);
+    if (index != NO_OUTPUT)
+    {
+        bytes += output.getDmaBytes(index);
+    }
+#endif
+    return bytes;
+}
+
+size_t LightUtils::getArenaUsed(void)
+{
+    return arena.getUsed();
+}
+
+uint32_t LightUtils::getFrameWireUs(void)
+{
+#if APA102_USE_SPI_DMA
+    return output.getWireUs();
+#else
+    // FastLED's driver runs at 4 MHz and pushes the strips one after another
+    return (uint32_t)((uint64_t)(numLeds * 4 + 8) * 8 * 1000000 / 4000000);
+#endif
+}
+
+/**
+ * Recompiles the pixel map from PIXEL_MAP_FILE, or the built-in layout. The
+ * render task picks up the new table at the start of a frame.
+ */
+void LightUtils::rebuildPixelMap(void)
+{
+    if (!numLeds)
+    {
+        return; // Not sized yet, begin() builds it
+    }
+    pixelMap.build(layout, snapshotConfig().reverseSecondRow);
+}
+
+PixelMap &LightUtils::getPixelMap(void)
+{
+    return pixelMap;
+}
+
+PowerLimiter &LightUtils::getPowerLimiter(void)
+{
+    return power;
+}
+
+SegmentPool &LightUtils::getSegments(void)
+{
+    return segments;
+}
 
-// New methods for protected LEDs
 
 /**
  * Protect a range of LEDs from being updated by pattern generators
- * and set them to a specific color.
+ * and set them to a specific color. They're a replace layer on top of the
+ * effects, see LayerStack.
  * 
  * @param start The starting index of the range (inclusive)
  * @param end The ending index of the range (inclusive)
  * @param color The color to set the protected LEDs to
  */
 void LightUtils::protectLedRange(uint16_t start, uint16_t end, CRGB color) {
-    if (start >= NUM_LEDS || end >= NUM_LEDS || start > end) {
+    if (!layers.setRange(PROTECTED_LAYER, start, end, color, LayerBlend::Replace, 255)) {
         Serial.println("Invalid LED range specified for protection");
-        return;
-    }
-    
-    for (uint16_t i = start; i <= end; i++) {
-        protectedLeds[i] = true;
-        leds[i] = color;
     }
-    
-    // Log the protection for debugging
-    /*
-    Serial.print("Protected LEDs ");
-    Serial.print(start);
-    Serial.print(" through ");
-    Serial.println(end);
-    */
 }
 
 /**
  * Unprotect all LEDs, allowing them to be updated by pattern generators
  */
 void LightUtils::unprotectAllLeds() {
-    for (uint16_t i = 0; i < NUM_LEDS; i++) {
-        protectedLeds[i] = false;
-    }
+    layers.remove(PROTECTED_LAYER);
     Serial.println("Unprotected all LEDs");
 }
 
@@ -823,9 +1873,13 @@ void LightUtils::unprotectAllLeds() {
  * Check if an LED is protected
  * 
  * @param index The index of the LED to check
- * @return true if the LED is protected, false otherwise
+ * @return true if any layer covers the LED, false otherwise
  */
 bool LightUtils::isLedProtected(uint16_t index) {
-    if (index >= NUM_LEDS) return false;
-    return protectedLeds[index];
-}
\ No newline at end of file
+    return layers.covers(index);
+}
+
+LayerStack &LightUtils::getLayers(void)
+{
+    return layers;
+}
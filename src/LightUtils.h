@@ -5,41 +5,164 @@
 #include "configuration.h"
 #include <FastLED.h>
 #include "utilities/PreferencesManager.h"
+#include "LightCommandQueue.h"
+#include "FrameScheduler.h"
+#include "FramePipeline.h"
+#include "MultiStripOutput.h"
+#include "PixelArena.h"
+#include "PixelMap.h"
+#include "SegmentPool.h"
+#include "PaletteLut.h"
+#include "PaletteBlend.h"
+#include "PowerLimiter.h"
+#include "EffectFade.h"
+#include "LayerStack.h"
+#include "effects/Effect.h"
+#include "effects/ParticlePool.h"
 extern PreferencesManager manager;
-// COOLING: How much does the air cool as it rises?
-// Less cooling = taller flames.  More cooling = shorter flames.
-// Default 55, suggested range 20-100
-#define COOLING 55
-// SPARKING: What chance (out of 255) is there that a new spark will be lit?
-// Higher chance = more roaring fire.  Lower chance = more flickery fire.
-// Default 120, suggested range 50-200.
-#define SPARKING 120
-#define NUM_LEDS 30
 #define LED_TYPE APA102
 #define COLOR_ORDER BGR
+
+/*
+    In-RAM copy of the lighting configuration.
+
+    Loaded from preferences once at startup. The render task works from a
+    per-frame copy of this so the hot loop never touches NVS.
+
+    This is persisted as a single blob behind a LightConfigHeader. Fields may
+    only be appended: older blobs are loaded by copying their bytes over the
+    defaults, so new fields pick up their default value. Bump
+    LIGHT_CONFIG_VERSION whenever a field is added, and add the previous
+    version's last field to lightConfigPayload(), since a new field can land
+    in what was padding at the end of the old layout.
+*/
+#define LIGHT_CONFIG_KEY "lightCfg"
+#define LIGHT_EFFECT_NAME_LENGTH 12 // Including the terminator
+#define LIGHT_TEXT_LENGTH 32
+#define LIGHT_CONFIG_VERSION 7
+
+struct LightConfigHeader
+{
+    uint16_t version; // LIGHT_CONFIG_VERSION that wrote the blob
+    uint16_t size;    // sizeof(LightConfig) that wrote the blob
+};
+
+struct LightConfig
+{
+    uint8_t program = 1;
+    uint8_t sin = 0;
+    uint8_t brightness = 255;
+    uint16_t updates = 100;
+    bool reverse = false;
+    bool fire = false;
+    bool localDisable = false;
+    bool autoLight = false;
+    uint32_t autoTime = 30;
+    bool reverseSecondRow = false;
+    bool circularMode = false; // Circular animation mode
+    // Version 2
+    uint16_t blendTime = 2000; // Palette transitions, in ms
+    // Version 3
+    uint8_t circularArms = 1;  // Times the circular pattern repeats around the ring
+    int8_t circularSpin = 16;  // Rotation per frame in 1/16ths of a palette step, negative spins backwards
+    // Version 4
+    uint16_t fadeTime = 1000;                          // Effect crossfades, in ms
+    uint8_t fadeCurve = (uint8_t)FadeCurve::EaseInOut; // FadeCurve
+    // Version 5
+    uint8_t fireCooling = DEFAULT_COOLING;
+    uint8_t fireSparking = DEFAULT_SPARKING;
+    uint8_t fireColumns = 1; // Independent flames along the strip
+    // Version 6
+    char effect[LIGHT_EFFECT_NAME_LENGTH] = ""; // Registered effect to show, empty for the fire and circular flags
+    char text[LIGHT_TEXT_LENGTH] = "";          // For the text effect
+    // Version 7
+    uint8_t particleCap = DEFAULT_PARTICLE_CAP; // Particle effects, 1 to MAX_PARTICLES
+};
+
+size_t lightConfigPayload(const LightConfigHeader &header); // Bytes of a stored LightConfig that are real fields
+void sanitizeConfig(LightConfig &config);                  // Clamp to the limits the UI enforces, every load path goes through this
+
 class LightUtils
 {
 private:
-    CRGBPalette16 getPalette(uint32_t paletteSelect, bool saveSelection);
-    void FillLEDsFromPaletteColors(uint8_t colorIndex);
-    void Fire2012WithPalette(void);
-    uint8_t cfgSin = 0;
-    uint8_t cfgProgram = 1;
-    uint8_t cfgBrightness = 255;
-    uint16_t cfgUpdates = 100;
-    bool cfgReverse = 0;
-    bool cfgFire = 0;
-    bool cfgLocalDisable = 0;
-    bool cfgCircularMode = 0; // New flag for circular animation mode
-    CRGB leds[NUM_LEDS];
-    bool protectedLeds[NUM_LEDS] = {false}; // Track which LEDs are protected from pattern updates
-    uint32_t cfgAutoTime = 0;
-    bool cfgAuto = 0;
-    bool cfgReverseSecondRow = false;
-    uint16_t mapLedIndex(uint16_t index);
+    // Render task state for one segment, indexed like frameSegments
+    struct SegmentState
+    {
+        PaletteBlend palette;
+        uint8_t program;
+        uint8_t startIndex;
+        Effect *effect; // SegmentConfig::effect looked up, or the fire flag's
+    };
+
+    void selectBasePalette(uint32_t paletteSelect);
+    void selectPalette(uint32_t paletteSelect, CRGBPalette16 &palette);
+    Effect *selectEffect(bool fire, bool circular);
+    void renderSpan(Effect *effect, CRGB *buffer, uint16_t first, uint16_t count, const PaletteBlend &palette, PaletteLut &lut, const EffectSettings &settings);
+    void renderBase(uint16_t first, uint16_t count, uint8_t startIndex);
+    void renderSegments(uint8_t startIndex);
+    void applySegments(void);
+    LightConfig cfg;      // Shared copy for the getters, only accessed under cfgMux
+    LightConfig frameCfg; // Render task's copy, updated from the command queue at the start of every frame
+    LightCommandQueue commands;
+    FrameScheduler scheduler;
+    FramePipeline pipeline;
+    PowerLimiter power; // Only touched by the output task after begin()
+    EffectFade fade;           // Crossfade between main effects
+    Effect *baseEffect = NULL; // Main effect fading in or showing
+    Effect *namedEffect = NULL; // frameCfg.effect looked up, NULL to go by the flags
+    bool effectChanged = true;  // frameCfg.effect needs looking up again
+    uint32_t renderedFrames = 0;
+    uint16_t canvasWidth = 0; // This frame's 2D row length, from the pixel map or the whole strip
+    PaletteLut fadeLut;        // Palette table of the outgoing effect
+#if APA102_USE_SPI_DMA
+    MultiStripOutput output;
+    static const uint8_t NO_OUTPUT = 0xFF;
+    uint8_t stripOutput[MAX_STRIPS] = {NO_OUTPUT, NO_OUTPUT}; // Output index of each slot, NO_OUTPUT if it didn't come up
+    uint8_t outputIndex(uint8_t strip);
+#else
+    CLEDController *ledController = NULL;
+    CLEDController *ledController2 = NULL;
+#endif
+    void applyCommands(void);
+    uint8_t renderedProgram = 0; // Program the target palette was last selected for
+    portMUX_TYPE cfgMux = portMUX_INITIALIZER_UNLOCKED;
+    LightConfig snapshotConfig(void);
+    void loadConfig(void);
+    void migrateLegacyConfig(void);
+    void saveConfig(void);
+    StripLayout layout;
+    PixelArena arena;
+    uint16_t numLeds = 0;              // Total across all strips, set by begin()
+    CRGB *leds = NULL;                 // The frame buffer being rendered
+    LayerStack layers;                 // Overlays on top of the effects, protected LEDs among them
+    uint8_t *heat = NULL;              // Fire2012 temperature per LED
+    PixelMap pixelMap;
+    const uint16_t *pixelTable = NULL; // This frame's logical to physical map
+    uint16_t mappedLeds = 0;           // Logical pixels in pixelTable
+    uint8_t framesToClear = 0;         // Buffers still holding pixels the new map no longer covers
+    SegmentPool segments;
+    SegmentConfig frameSegments[MAX_SEGMENTS]; // Render task's copy, sorted by start
+    SegmentState segmentStates[MAX_SEGMENTS];
+    SegmentConfig spareSegments[MAX_SEGMENTS]; // Scratch for applySegments()
+    SegmentState spareStates[MAX_SEGMENTS];
+    uint32_t circularPhase = 0;            // Ring rotation, a full turn is 2^32
+    uint32_t lastPushHash = 0;             // Output task only
+    uint32_t lastPushMs = 0;
+    bool pushedOnce = false;
+    Effect *paletteEffect = NULL;          // Looked up from EffectRegistry at startup
+    Effect *circularEffect = NULL;
+    Effect *fireEffect = NULL;
+    PaletteBlend basePalette;              // Main configuration's palette transitions
+    PaletteLut baseLut;                    // Expanded palette for the main configuration
+    PaletteLut segmentLuts[MAX_SEGMENTS];  // ... and for each segment, indexed like frameSegments
+    uint8_t frameSegmentCount = 0;
 public:
     LightUtils();
+    bool begin(const StripLayout &stripLayout); // Allocate the LED buffers and bring up the strips
     void loop();
+    void outputLoop(); // Called repeatedly by the output task
+    LightConfig getConfig(void);
+    void applyConfig(const LightConfig &requested); // Replace the whole configuration at the next frame
     void setCfgSin(uint8_t sin);
     void setCfgReverse(bool reverse);
     void setCfgFire(bool fire);
@@ -51,6 +174,15 @@ public:
     void setCfgAutoTime(uint32_t updates);
     void setCfgReverseSecondRow(bool reverse);
     void setCfgCircularMode(bool circularMode); // New setter for circular mode
+    void setCfgBlendTime(uint16_t blendTime);
+    void setCfgCircularArms(uint8_t arms);
+    void setCfgCircularSpin(int8_t spin);
+    void setCfgFadeTime(uint16_t fadeTime);
+    void setCfgFadeCurve(FadeCurve curve);
+    void setCfgFire(uint8_t cooling, uint8_t sparking, uint8_t columns);
+    bool setCfgEffect(const char *name); // A registered effect, or "" to go by the fire and circular flags
+    void setCfgText(const char *text);
+    void setCfgParticleCap(uint8_t cap);
     bool getCfgReverseSecondRow(void);
     bool getCfgReverse(void);
     bool getCfgFire(void);
@@ -62,10 +194,35 @@ public:
     uint8_t getCfgProgram(void);
     uint8_t getCfgBrightness(void);
     uint16_t getCfgUpdates(void);
+    uint16_t getCfgBlendTime(void);
+    uint8_t getCfgCircularArms(void);
+    int8_t getCfgCircularSpin(void);
+    uint16_t getCfgFadeTime(void);
+    FadeCurve getCfgFadeCurve(void);
+    uint8_t getCfgFireCooling(void);
+    uint8_t getCfgFireSparking(void);
+    uint8_t getCfgFireColumns(void);
+    String getCfgEffect(void);
+    String getCfgText(void);
+    uint8_t getCfgParticleCap(void);
+    uint8_t getBlendProgress(void); // 255 once the main palette has converged
+    LightCommandQueue &getCommandQueue(void);
+    FrameScheduler::FrameStats getFrameStats(void);
+    FramePipeline &getPipeline(void);
     CRGB *getLeds(void);
     uint16_t getNumberOfLeds(void);
+    const StripLayout &getStripLayout(void);
+    size_t getStripMemory(uint8_t strip); // Arena and DMA bytes used for one strip
+    uint8_t getDitherBits(uint8_t strip); // Temporal dithering bits, 0 when off
+    PowerLimiter &getPowerLimiter(void);
+    size_t getArenaUsed(void);
+    uint32_t getFrameWireUs(void); // Time a pushed frame spends on the wire
+    void rebuildPixelMap(void); // Re-read PIXEL_MAP_FILE, eg: after uploading a new one
+    PixelMap &getPixelMap(void);
+    SegmentPool &getSegments(void);
+    LayerStack &getLayers(void);
     
-    // New methods for protected LEDs
+    // Protected LEDs, kept as a replace layer
     void protectLedRange(uint16_t start, uint16_t end, CRGB color); // Protect LEDs and set them to a specific color
     void unprotectAllLeds(); // Unprotect all LEDs
     bool isLedProtected(uint16_t index); // Check if an LED is protected
@@ -0,0 +1,119 @@
+#include "MultiStripOutput.h"
+
+/**
+ * Adds a strip driving numLeds pixels of the frame from offset on. The
+ * offset is explicit so a strip that fails to come up doesn't shift the
+ * ones after it onto its pixels.
+ *
+ * @return true if the strip's SPI host came up. Nothing is recorded otherwise.
+ */
+bool MultiStripOutput::addStrip(spi_host_device_t host, int dataPin, int clockPin, uint16_t offset, uint16_t numLeds, uint32_t clockHz, const ColorSettings &color)
+{
+    if (stripCount == MAX_STRIPS)
+    {
+        Serial.println("MultiStripOutput: no free SPI host for another strip");
+        return false;
+    }
+
+    if (!strips[stripCount].begin(host, dataPin, clockPin, numLeds, clockHz))
+    {
+        return false;
+    }
+
+    strips[stripCount].setColorSettings(color);
+
+    offsets[stripCount] = offset;
+    lengths[stripCount] = numLeds;
+    // Strips needn't be packed, so the frame has to reach the end of the furthest one
+    totalLeds = max(totalLeds, (uint16_t)(offset + numLeds));
+    stripCount++;
+    return true;
+}
+
+/**
+ * Encodes and queues every strip's region of the frame. The transfers run
+ * concurrently on their own SPI hosts.
+ *
+ * @param frame The whole frame, at least getTotalLeds() pixels.
+ * @param brightness Applied to every strip. 0 pushes black.
+ */
+void MultiStripOutput::show(const CRGB *frame, uint8_t brightness)
+{
+    for (uint8_t i = 0; i < stripCount; i++)
+    {
+        strips[i].show(frame + offsets[i], brightness);
+    }
+}
+
+void MultiStripOutput::show(const CRGB *frame, const uint8_t *brightness)
+{
+    for (uint8_t i = 0; i < stripCount; i++)
+    {
+        strips[i].show(frame + offsets[i], brightness[i]);
+    }
+}
+
+void MultiStripOutput::waitDone(void)
+{
+    for (uint8_t i = 0; i < stripCount; i++)
+    {
+        strips[i].waitDone(portMAX_DELAY);
+    }
+}
+
+uint8_t MultiStripOutput::getStripCount(void)
+{
+    return stripCount;
+}
+
+uint16_t MultiStripOutput::getStripOffset(uint8_t strip)
+{
+    return strip < stripCount ? offsets[strip] : 0;
+}
+
+uint16_t MultiStripOutput::getStripLength(uint8_t strip)
+{
+    return strip < stripCount ? lengths[strip] : 0;
+}
+
+uint16_t MultiStripOutput::getTotalLeds(void)
+{
+    return totalLeds;
+}
+
+uint32_t MultiStripOutput::getCompleted(uint8_t strip)
+{
+    return strip < stripCount ? strips[strip].getCompleted() : 0;
+}
+
+size_t MultiStripOutput::getDmaBytes(uint8_t strip)
+{
+    return strip < stripCount ? strips[strip].getBufferLength() * 2 : 0;
+}
+
+uint32_t MultiStripOutput::getWireUs(void)
+{
+    uint32_t longest = 0;
+    for (uint8_t i = 0; i < stripCount; i++)
+    {
+        longest = max(longest, strips[i].getWireUs());
+    }
+    return longest;
+}
+
+bool MultiStripOutput::isDithering(void)
+{
+    for (uint8_t i = 0; i < stripCount; i++)
+    {
+        if (strips[i].getColorStage().isDithering())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t MultiStripOutput::getDitherBits(uint8_t strip)
+{
+    return strip < stripCount ? strips[strip].getColorStage().getDitherBits() : 0;
+}
@@ -0,0 +1,46 @@
+#ifndef MULTISTRIPOUTPUT_H
+#define MULTISTRIPOUTPUT_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "configuration.h"
+#include "Apa102Spi.h"
+
+/*
+    Drives several APA102 strips from one frame buffer at the same time.
+
+    Each strip owns a contiguous region of the frame and its own SPI host, so
+    show() queues every strip's DMA transfer back to back and they all clock
+    out in parallel. Frame output time is that of the longest strip, not the
+    sum of all of them.
+*/
+class MultiStripOutput
+{
+private:
+    Apa102Spi strips[MAX_STRIPS];
+    uint16_t offsets[MAX_STRIPS] = {0};
+    uint16_t lengths[MAX_STRIPS] = {0};
+    uint8_t stripCount = 0;
+    uint16_t totalLeds = 0;
+
+public:
+    bool addStrip(spi_host_device_t host, int dataPin, int clockPin, uint16_t offset, uint16_t numLeds, uint32_t clockHz, const ColorSettings &color);
+
+    void show(const CRGB *frame, uint8_t brightness); // Queue every strip and return
+    void show(const CRGB *frame, const uint8_t *brightness); // Same, with one brightness per strip
+    void waitDone(void);                              // Block until every strip is out
+
+    uint8_t getStripCount(void);
+    uint16_t getStripOffset(uint8_t strip);
+    uint16_t getStripLength(uint8_t strip);
+    uint16_t getTotalLeds(void);
+    uint32_t getCompleted(uint8_t strip);
+    size_t getDmaBytes(uint8_t strip); // Both DMA buffers
+    uint32_t getWireUs(void);          // Time a frame spends on the wire, the longest strip
+    bool isDithering(void);            // Any strip dithers, so output changes even when the frame doesn't
+    uint8_t getDitherBits(uint8_t strip);
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "PaletteBlend.h"
+
+void PaletteBlend::reset(const CRGBPalette16 &palette)
+{
+    from = palette;
+    target = palette;
+    current = palette;
+    progress = 255;
+    // Both show the same palette, so they can share a number
+    version = targetVersion = ++lastVersion;
+}
+
+/**
+ * Starts a blend from the palette showing now. Setting the palette that's
+ * already the target does nothing, so a blend in progress isn't restarted.
+ */
+void PaletteBlend::setTarget(const CRGBPalette16 &palette, uint32_t now)
+{
+    if (palette == target)
+    {
+        return;
+    }
+
+    from = current;
+    target = palette;
+    targetVersion = ++lastVersion;
+    startMs = now;
+    progress = 0;
+}
+
+void PaletteBlend::setDuration(uint16_t ms)
+{
+    durationMs = ms;
+}
+
+/**
+ * Advances the blend to now.
+ *
+ * @return true if the current palette changed, false once the blend has
+ *         converged or if it didn't move since the last frame.
+ */
+bool PaletteBlend::step(uint32_t now)
+{
+    if (progress == 255)
+    {
+        return false;
+    }
+
+    uint32_t elapsed = now - startMs;
+    uint8_t amount = elapsed >= durationMs ? 255 : (elapsed * 255) / durationMs;
+    if (amount == progress)
+    {
+        return false;
+    }
+    progress = amount;
+
+    if (progress == 255)
+    {
+        current = target;
+    }
+    else
+    {
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            current[i] = blend(from[i], target[i], progress);
+        }
+    }
+    version = ++lastVersion;
+    return true;
+}
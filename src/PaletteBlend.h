@@ -0,0 +1,50 @@
+#ifndef PALETTEBLEND_H
+#define PALETTEBLEND_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+/*
+    A timed transition from one palette to another.
+
+    setTarget() starts a blend from whatever is showing now; step() advances
+    it once per frame along a linear ramp lasting the configured duration.
+    Once the blend reaches the target it stops doing any work until the next
+    setTarget().
+
+    getVersion() changes only on frames where the current palette actually
+    changed, and getTargetVersion() only when a new target is set, so caches
+    built from either palette know exactly when to rebuild. Both are drawn
+    from one counter, so a version number only ever names one palette and a
+    cache can be fed from either without mixing them up.
+*/
+class PaletteBlend
+{
+private:
+    CRGBPalette16 from;
+    CRGBPalette16 target;
+    CRGBPalette16 current;
+    uint32_t startMs = 0;
+    uint16_t durationMs = 0;
+    uint8_t progress = 255; // 255 once current has reached target
+    uint32_t lastVersion = 0; // Last number handed out to either palette
+    uint32_t version = 0;
+    uint32_t targetVersion = 0;
+
+public:
+    void reset(const CRGBPalette16 &palette);                  // Show palette straight away, no blend
+    void setTarget(const CRGBPalette16 &palette, uint32_t now); // Start blending towards palette
+    void setDuration(uint16_t ms);
+    bool step(uint32_t now); // Returns true if the current palette changed
+
+    const CRGBPalette16 &getCurrent(void) const { return current; }
+    const CRGBPalette16 &getTarget(void) const { return target; }
+    uint32_t getVersion(void) const { return version; }
+    uint32_t getTargetVersion(void) const { return targetVersion; }
+    uint8_t getProgress(void) const { return progress; }
+    bool isBlending(void) const { return progress != 255; }
+};
+
+#endif
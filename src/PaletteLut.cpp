@@ -0,0 +1,33 @@
+#include "PaletteLut.h"
+
+/**
+ * Rebuilds the table if the palette or brightness changed since it was built.
+ *
+ * @param version The palette's version, see PaletteBlend::getVersion().
+ * @return true if the table was rebuilt.
+ */
+bool PaletteLut::update(const CRGBPalette16 &palette, uint32_t version, uint8_t brightness)
+{
+    if (valid && version == sourceVersion && brightness == sourceBrightness)
+    {
+        return false;
+    }
+    build(palette, brightness);
+    sourceVersion = version;
+    return true;
+}
+
+void PaletteLut::build(const CRGBPalette16 &palette, uint8_t brightness)
+{
+    for (uint16_t i = 0; i < 256; i++)
+    {
+        entries[i] = ColorFromPalette(palette, i, brightness);
+    }
+    sourceBrightness = brightness;
+    valid = true;
+}
+
+void PaletteLut::invalidate(void)
+{
+    valid = false;
+}
@@ -0,0 +1,40 @@
+#ifndef PALETTELUT_H
+#define PALETTELUT_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+/*
+    A CRGBPalette16 expanded to all 256 indexes, with brightness applied.
+
+    ColorFromPalette() interpolates between two of the 16 entries and scales
+    the result on every call. The expanded table does that once per palette
+    and brightness, so the fill kernels do one table read per pixel. Each
+    entry is exactly what ColorFromPalette() would have returned.
+
+    The palette's owner passes a version that changes whenever the palette
+    does (see PaletteBlend), so checking for a rebuild costs nothing.
+*/
+class PaletteLut
+{
+private:
+    CRGB entries[256];
+    uint32_t sourceVersion = 0;
+    uint8_t sourceBrightness = 0;
+    bool valid = false;
+
+public:
+    // Rebuild if the palette version or brightness changed. Returns true if it did.
+    bool update(const CRGBPalette16 &palette, uint32_t version, uint8_t brightness);
+    void build(const CRGBPalette16 &palette, uint8_t brightness);  // Unconditional rebuild
+    void invalidate(void);
+
+    inline const CRGB &operator[](uint8_t index) const
+    {
+        return entries[index];
+    }
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include <esp_heap_caps.h>
+#include "PixelArena.h"
+
+/**
+ * Allocates the arena. Only called once, at boot.
+ *
+ * @param bytes Total size, the sum of footprint() for everything that will be taken.
+ * @return false if the heap couldn't supply it.
+ */
+bool PixelArena::begin(size_t bytes)
+{
+    base = (uint8_t *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    if (!base)
+    {
+        Serial.printf("PixelArena: failed to allocate %u bytes\n", bytes);
+        capacity = 0;
+        return false;
+    }
+
+    memset(base, 0, bytes);
+    capacity = bytes;
+    used = 0;
+    return true;
+}
+
+size_t PixelArena::getCapacity(void)
+{
+    return capacity;
+}
+
+size_t PixelArena::getUsed(void)
+{
+    return used;
+}
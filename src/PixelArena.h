@@ -0,0 +1,76 @@
+#ifndef PIXELARENA_H
+#define PIXELARENA_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "configuration.h"
+#include "ColorStage.h"
+
+/*
+    Strip topology, read from the config file at boot.
+
+    Strips are laid out one after another in the frame, in slot order. Each
+    slot has fixed pins (see configuration.h); a slot with 0 LEDs isn't
+    fitted.
+*/
+struct StripLayout
+{
+    uint16_t leds[MAX_STRIPS] = {STRIP1_NUM_LEDS, STRIP2_NUM_LEDS};
+    ColorSettings color[MAX_STRIPS]; // Output stage for each strip
+    uint16_t maxMilliamps[MAX_STRIPS] = {0}; // Current budget for each strip, 0 is unlimited
+
+    uint16_t total(void) const
+    {
+        uint16_t sum = 0;
+        for (uint8_t i = 0; i < MAX_STRIPS; i++)
+        {
+            sum += leds[i];
+        }
+        return sum;
+    }
+};
+
+/*
+    One allocation holding every per-LED buffer.
+
+    Sized once at boot from the strip layout, then carved up with take().
+    Nothing is ever returned to it, so per-LED state can't fragment the heap
+    and the whole footprint is known up front.
+*/
+class PixelArena
+{
+private:
+    uint8_t *base = NULL;
+    size_t capacity = 0;
+    size_t used = 0;
+
+public:
+    // Bytes take() uses for count items of T, including alignment padding
+    template <typename T>
+    static size_t footprint(size_t count)
+    {
+        return (count * sizeof(T) + 3) & ~(size_t)3;
+    }
+
+    bool begin(size_t bytes);
+
+    // Zeroed, 4-byte aligned. NULL once the arena is exhausted.
+    template <typename T>
+    T *take(size_t count)
+    {
+        size_t bytes = footprint<T>(count);
+        if (!base || used + bytes > capacity)
+        {
+            return NULL;
+        }
+        T *block = (T *)(base + used);
+        used += bytes;
+        return block;
+    }
+
+    size_t getCapacity(void);
+    size_t getUsed(void);
+};
+
+#endif
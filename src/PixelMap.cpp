@@ -0,0 +1,198 @@
+#include <LittleFS.h>
+#include <ArduinoJson.h>
+#include "PixelMap.h"
+
+size_t PixelMap::arenaBytes(uint16_t ledCount)
+{
+    return PixelArena::footprint<uint16_t>(ledCount) * 2;
+}
+
+/**
+ * Hands the map its two tables and fills the active one with the identity,
+ * so the render task has something valid before the first build().
+ */
+void PixelMap::begin(uint16_t *storage, uint16_t ledCount)
+{
+    numLeds = ledCount;
+    tables[0] = storage;
+    tables[1] = storage + PixelArena::footprint<uint16_t>(ledCount) / sizeof(uint16_t);
+    buildMutex = xSemaphoreCreateMutex();
+
+    for (uint16_t i = 0; i < numLeds; i++)
+    {
+        tables[0][i] = i;
+    }
+    lengths[0] = numLeds;
+    active = 0;
+}
+
+/**
+ * Compiles the table from the map file, falling back to the built-in layout,
+ * and leaves it for the render task to swap in.
+ *
+ * @param layout The strip layout the frame was sized from.
+ * @param reverseSecondRow Built-in two-row layout, only used without a map file.
+ */
+void PixelMap::build(const StripLayout &layout, bool reverseSecondRow)
+{
+    if (!buildMutex)
+    {
+        return;
+    }
+
+    xSemaphoreTake(buildMutex, portMAX_DELAY);
+
+    uint8_t target = active ^ 1;
+    uint32_t start = micros();
+    uint16_t width = 0;
+    uint16_t length = loadFile(PIXEL_MAP_FILE, tables[target], width);
+    if (length)
+    {
+        source = PIXEL_MAP_FILE;
+    }
+    else
+    {
+        length = buildBuiltIn(layout, reverseSecondRow, tables[target]);
+        source = reverseSecondRow ? "two-row" : "identity";
+    }
+    lengths[target] = length;
+    widths[target] = width;
+    pending = true;
+    rebuilds++;
+
+    xSemaphoreGive(buildMutex);
+
+    Serial.printf("Pixel map: %u of %u pixels from %s in %lu us\n", length, numLeds, source, micros() - start);
+}
+
+/**
+ * Swaps in a newly built table. If a build is still running the swap is left
+ * for the next frame rather than waiting for it.
+ *
+ * @return true if the table changed.
+ */
+bool PixelMap::apply(void)
+{
+    if (!pending || xSemaphoreTake(buildMutex, 0) != pdTRUE)
+    {
+        return false;
+    }
+
+    active ^= 1;
+    pending = false;
+    xSemaphoreGive(buildMutex);
+    return true;
+}
+
+/**
+ * Parses the runs in the map file into table.
+ *
+ * @param canvasWidth Set to the canvas row length, 0 if the file doesn't give one.
+ * @return The number of logical pixels, 0 if there's no usable file.
+ */
+uint16_t PixelMap::loadFile(const char *path, uint16_t *table, uint16_t &canvasWidth)
+{
+    if (!LittleFS.exists(path))
+    {
+        return 0;
+    }
+
+    File file = LittleFS.open(path, FILE_READ);
+    if (!file)
+    {
+        return 0;
+    }
+
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error)
+    {
+        Serial.printf("Pixel map: %s failed to parse: %s\n", path, error.c_str());
+        return 0;
+    }
+
+    canvasWidth = doc["width"] | 0;
+    uint16_t length = 0;
+    for (JsonObjectConst run : doc["runs"].as<JsonArrayConst>())
+    {
+        uint16_t first = run["start"] | 0;
+        uint16_t rows = run["rows"] | 1;
+        uint16_t width = run["width"] | (run["length"] | 0);
+        bool reverse = run["reverse"] | false;
+
+        if ((uint32_t)first + (uint32_t)rows * width > numLeds || length + rows * width > numLeds)
+        {
+            Serial.printf("Pixel map: run at %u doesn't fit in %u LEDs\n", first, numLeds);
+            return 0;
+        }
+        if (!canvasWidth && rows > 1)
+        {
+            canvasWidth = width;
+        }
+
+        for (uint16_t row = 0; row < rows; row++)
+        {
+            uint16_t rowStart = first + row * width;
+            // Serpentine rows alternate direction
+            bool rowReverse = reverse ^ (row & 1);
+            for (uint16_t x = 0; x < width; x++)
+            {
+                table[length++] = rowReverse ? rowStart + width - 1 - x : rowStart + x;
+            }
+        }
+    }
+
+    return length;
+}
+
+/**
+ * The identity map, or with reverseSecondRow the original fixture: a row of
+ * 12 followed by a second row, on the first strip, that runs back the other way.
+ *
+ * @return The number of logical pixels, always every LED.
+ */
+uint16_t PixelMap::buildBuiltIn(const StripLayout &layout, bool reverseSecondRow, uint16_t *table)
+{
+    for (uint16_t i = 0; i < numLeds; i++)
+    {
+        table[i] = i;
+    }
+
+    const uint16_t firstRow = 12;
+    uint16_t rowsEnd = layout.leds[0];
+    if (reverseSecondRow && rowsEnd > firstRow)
+    {
+        for (uint16_t i = firstRow; i < rowsEnd; i++)
+        {
+            table[i] = rowsEnd - 1 - (i - firstRow);
+        }
+    }
+
+    return numLeds;
+}
+
+const uint16_t *PixelMap::getTable(void)
+{
+    return tables[active];
+}
+
+uint16_t PixelMap::getLength(void)
+{
+    return lengths[active];
+}
+
+uint16_t PixelMap::getWidth(void)
+{
+    return widths[active];
+}
+
+uint32_t PixelMap::getRebuilds(void)
+{
+    return rebuilds;
+}
+
+const char *PixelMap::getSource(void)
+{
+    return source;
+}
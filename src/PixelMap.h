@@ -0,0 +1,78 @@
+#ifndef PIXELMAP_H
+#define PIXELMAP_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "PixelArena.h"
+
+#define PIXEL_MAP_FILE "/pixelmap.json"
+
+/*
+    Logical to physical pixel lookup table.
+
+    Effects render logical pixels 0 to getLength() - 1 and write each one to
+    the frame at getTable()[i], so mapping costs one lookup per pixel whatever
+    the fixture shape. Physical pixels that nothing maps to stay black.
+
+    The table comes from PIXEL_MAP_FILE, a list of runs laid out in logical
+    order. Each run places "length" pixels starting at physical pixel "start",
+    optionally reversed. A run with "rows" is a serpentine: "rows" rows of
+    "width" pixels, each row running the opposite way to the one before.
+    Leaving physical pixels out of every run leaves a gap.
+
+    {
+        "runs": [
+            { "start": 0, "length": 12 },
+            { "start": 12, "length": 18, "reverse": true },
+            { "start": 40, "width": 8, "rows": 4 }
+        ]
+    }
+
+    The file also gives 2D effects their XY map: logical pixels fill the
+    canvas row by row, "width" pixels to a row. Without a top level "width"
+    the first serpentine run's width is used, so a single serpentine run
+    describes a whole panel.
+
+    {
+        "width": 32,
+        "runs": [ { "start": 0, "width": 32, "rows": 32 } ]
+    }
+
+    Without the file the table is the identity, or the built-in two-row
+    layout when reverseSecondRow is set, and the canvas is one row.
+
+    Building happens off the render task, into a second table. The render task
+    swaps it in at the start of a frame, so a rebuild never tears a frame.
+*/
+class PixelMap
+{
+private:
+    uint16_t *tables[2] = {NULL, NULL};
+    uint16_t lengths[2] = {0, 0};
+    uint16_t widths[2] = {0, 0}; // Canvas row length, 0 for one row
+    uint8_t active = 0;
+    uint16_t numLeds = 0;
+    SemaphoreHandle_t buildMutex = NULL;
+    volatile bool pending = false; // The inactive table holds a newer map
+    uint32_t rebuilds = 0;
+    const char *source = "identity";
+
+    uint16_t loadFile(const char *path, uint16_t *table, uint16_t &canvasWidth);
+    uint16_t buildBuiltIn(const StripLayout &layout, bool reverseSecondRow, uint16_t *table);
+
+public:
+    static size_t arenaBytes(uint16_t ledCount);
+    void begin(uint16_t *storage, uint16_t ledCount); // arenaBytes() worth of storage
+
+    void build(const StripLayout &layout, bool reverseSecondRow); // Any task. Blocks while parsing the file.
+    bool apply(void);                                            // Render task only, at the start of a frame
+
+    const uint16_t *getTable(void);
+    uint16_t getLength(void);
+    uint16_t getWidth(void); // Canvas row length, 0 if the map has no rows
+    uint32_t getRebuilds(void);
+    const char *getSource(void);
+};
+
+#endif
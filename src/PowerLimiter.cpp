@@ -0,0 +1,85 @@
+#include "PowerLimiter.h"
+
+PowerLimiter::PowerLimiter()
+{
+    memset(scale, 255, sizeof(scale));
+}
+
+void PowerLimiter::setBudget(uint8_t strip, uint16_t milliamps)
+{
+    if (strip < MAX_STRIPS)
+    {
+        budgetMa[strip] = milliamps;
+        scale[strip] = 255;
+    }
+}
+
+/**
+ * Works out the brightness one strip can have this frame.
+ *
+ * @param strip Layout slot of the strip.
+ * @param sums Channel totals of the strip's pixels.
+ * @param count Pixels on the strip.
+ * @param brightness Brightness the frame asks for.
+ */
+uint8_t PowerLimiter::update(uint8_t strip, const ChannelSums &sums, uint16_t count, uint8_t brightness)
+{
+    if (strip >= MAX_STRIPS)
+    {
+        return brightness;
+    }
+
+    // Draw of the channels at full brightness, and of the LEDs doing nothing
+    uint32_t fullMa = (sums.r * POWER_MA_RED + sums.g * POWER_MA_GREEN + sums.b * POWER_MA_BLUE) / 255;
+    uint32_t idleMa = ((uint32_t)count * POWER_UA_IDLE) / 1000;
+
+    uint8_t wanted = 255;
+    if (budgetMa[strip] && brightness && fullMa)
+    {
+        // Highest brightness that fits, then as a scale of the requested one
+        uint32_t headroom = budgetMa[strip] > idleMa ? budgetMa[strip] - idleMa : 0;
+        uint32_t fits = (headroom * 255) / fullMa;
+        if (fits < brightness)
+        {
+            wanted = (fits * 255) / brightness;
+        }
+    }
+
+    if (wanted < scale[strip])
+    {
+        scale[strip] = wanted;
+    }
+    else
+    {
+        scale[strip] = min((uint16_t)wanted, (uint16_t)(scale[strip] + POWER_RELEASE_STEP));
+    }
+
+    uint8_t limited = brightness;
+    if (scale[strip] < 255)
+    {
+        limited = ((uint16_t)brightness * scale[strip]) >> 8;
+        limitedFrames++;
+    }
+    estimatedMa[strip] = idleMa + (fullMa * limited) / 255;
+    return limited;
+}
+
+uint16_t PowerLimiter::getBudget(uint8_t strip)
+{
+    return strip < MAX_STRIPS ? budgetMa[strip] : 0;
+}
+
+uint32_t PowerLimiter::getEstimatedMa(uint8_t strip)
+{
+    return strip < MAX_STRIPS ? estimatedMa[strip] : 0;
+}
+
+uint8_t PowerLimiter::getScale(uint8_t strip)
+{
+    return strip < MAX_STRIPS ? scale[strip] : 255;
+}
+
+uint32_t PowerLimiter::getLimitedFrames(void)
+{
+    return limitedFrames;
+}
@@ -0,0 +1,57 @@
+#ifndef POWERLIMITER_H
+#define POWERLIMITER_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "configuration.h"
+
+#define POWER_MA_RED 20    // APA102 channel current at full drive
+#define POWER_MA_GREEN 20
+#define POWER_MA_BLUE 20
+#define POWER_UA_IDLE 1000 // Per LED with every channel off, in microamps
+#define POWER_RELEASE_STEP 4 // How far the limit recovers per frame, out of 255
+
+/*
+    Channel totals over one strip's pixels, before brightness.
+*/
+struct ChannelSums
+{
+    uint32_t r = 0;
+    uint32_t g = 0;
+    uint32_t b = 0;
+};
+
+/*
+    Keeps each strip inside a current budget by scaling its brightness.
+
+    The draw is estimated from the channel sums of the frame being pushed, so
+    there's no separate pass over the pixels. When a frame would go over
+    budget the strip's scale drops straight to what fits; once the frame fits
+    again it climbs back by POWER_RELEASE_STEP per frame, so the strip
+    brightens smoothly instead of pumping.
+
+    Estimates use the rendered values. Gamma and color correction only ever
+    lower the real output, so they err on the safe side.
+*/
+class PowerLimiter
+{
+private:
+    uint16_t budgetMa[MAX_STRIPS] = {0}; // 0 is unlimited
+    uint8_t scale[MAX_STRIPS];           // Brightness scale currently applied, 255 is none
+    uint32_t estimatedMa[MAX_STRIPS] = {0};
+    uint32_t limitedFrames = 0;
+
+public:
+    PowerLimiter();
+
+    void setBudget(uint8_t strip, uint16_t milliamps);
+    uint8_t update(uint8_t strip, const ChannelSums &sums, uint16_t count, uint8_t brightness); // Returns the brightness to push
+
+    uint16_t getBudget(uint8_t strip);
+    uint32_t getEstimatedMa(uint8_t strip); // Of the last frame pushed, after limiting
+    uint8_t getScale(uint8_t strip);
+    uint32_t getLimitedFrames(void); // Strip frames pushed below the requested brightness
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include <FastLED.h>
+#include "configuration.h"
+#include "RenderBenchmark.h"
+#include "PaletteLut.h"
+#include "ColorStage.h"
+#include "effects/Effect.h"
+#include "effects/ParticlePool.h"
+
+static void report(Print &out, const char *name, uint32_t totalUs)
+{
+    out.printf("%-32s %8.1f us/frame\n", name, (float)totalUs / RENDER_BENCHMARK_FRAMES);
+}
+
+/**
+ * Encodes one APA102 frame the way the output does, with or without the color stage.
+ */
+template <bool Dither>
+static void encode(const CRGB *pixels, uint16_t numLeds, uint8_t *wire, ColorStage *stage, uint8_t brightness)
+{
+    for (uint16_t i = 0; i < numLeds; i++)
+    {
+        uint8_t r, g, b;
+        if (stage)
+        {
+            stage->apply<Dither>(pixels[i], i, r, g, b);
+        }
+        else
+        {
+            r = scale8(pixels[i].r, brightness);
+            g = scale8(pixels[i].g, brightness);
+            b = scale8(pixels[i].b, brightness);
+        }
+        *wire++ = 0xE0 | 31;
+        *wire++ = b;
+        *wire++ = g;
+        *wire++ = r;
+    }
+}
+
+/**
+ * Output encode cost, plain brightness scaling against gamma with and without dithering.
+ */
+static void benchmarkEncode(Print &out, const CRGB *pixels, uint16_t numLeds, uint8_t brightness)
+{
+    uint8_t *wire = (uint8_t *)malloc(numLeds * 4);
+    ColorStage *stage = new ColorStage();
+    if (!wire || !stage)
+    {
+        out.println("Not enough memory for the encode benchmark");
+        free(wire);
+        delete stage;
+        return;
+    }
+
+    uint32_t start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        encode<false>(pixels, numLeds, wire, NULL, brightness);
+    }
+    report(out, "encode: scale8", micros() - start);
+
+    ColorSettings settings;
+    settings.gamma = 2.2f;
+    settings.correction = 0xFFB0F0;
+    stage->configure(settings);
+    start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        stage->prepare(brightness);
+        encode<false>(pixels, numLeds, wire, stage, brightness);
+    }
+    report(out, "encode: gamma + correction", micros() - start);
+
+    settings.dither = true;
+    stage->configure(settings);
+    start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        stage->prepare(brightness);
+        encode<true>(pixels, numLeds, wire, stage, brightness);
+    }
+    report(out, "encode: gamma + dither", micros() - start);
+
+    free(wire);
+    delete stage;
+}
+
+/**
+ * Times an effect on an instance of its own, so the benchmark never touches
+ * state the render task's instance is using. It runs RENDER_BENCHMARK_FRAMES
+ * untimed first so effects that build up, like fire or particles, are timed
+ * at a steady load. For particle effects the average number alive while
+ * timing is reported.
+ *
+ * @param detail What the case varies, eg: "8 columns".
+ */
+static void timeEffect(Print &out, const char *effectName, const char *detail, const EffectTarget &target, EffectSettings &settings)
+{
+    Effect *effect = EffectRegistry::create(effectName);
+    if (!effect)
+    {
+        return;
+    }
+
+    uint16_t frame = 0;
+    for (; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        settings.frame = frame;
+        effect->render(target, settings);
+    }
+
+    uint32_t particles = 0;
+    uint32_t start = micros();
+    for (; frame < 2 * RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        settings.frame = frame;
+        effect->render(target, settings);
+        particles += effect->getParticleCount();
+    }
+    uint32_t elapsed = micros() - start;
+
+    char name[48];
+    if (particles)
+    {
+        snprintf(name, sizeof(name), "%s: %s, %lu alive", effectName, detail, (unsigned long)(particles / RENDER_BENCHMARK_FRAMES));
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%s: %s", effectName, detail);
+    }
+    report(out, name, elapsed);
+    delete effect;
+}
+
+/**
+ * Registered effects: fire as one flame and split into independent columns,
+ * the particle effects at the largest cap, and the 2D effects on a canvas
+ * RENDER_BENCHMARK_WIDTH pixels wide.
+ */
+static void benchmarkEffects(Print &out, CRGB *pixels, uint16_t numLeds, PaletteLut *lut)
+{
+    uint16_t *table = (uint16_t *)malloc(numLeds * sizeof(uint16_t));
+    uint8_t *heat = (uint8_t *)calloc(numLeds, 1);
+    if (!table || !heat)
+    {
+        out.println("Not enough memory for the effect benchmark");
+        free(table);
+        free(heat);
+        return;
+    }
+    for (uint16_t i = 0; i < numLeds; i++)
+    {
+        table[i] = i;
+    }
+
+    EffectTarget target = {pixels, table, heat, numLeds, lut};
+    EffectSettings settings = {};
+    settings.cooling = DEFAULT_COOLING;
+    settings.sparking = DEFAULT_SPARKING;
+    settings.text = "Benchmark";
+    settings.extent = numLeds;
+    settings.particles = MAX_PARTICLES;
+
+    settings.columns = 1;
+    timeEffect(out, "fire", "1 column", target, settings);
+    settings.columns = 8;
+    timeEffect(out, "fire", "8 columns", target, settings);
+
+    char detail[16];
+    snprintf(detail, sizeof(detail), "cap %u", MAX_PARTICLES);
+    timeEffect(out, "sparks", detail, target, settings);
+    timeEffect(out, "comets", detail, target, settings);
+    timeEffect(out, "fireworks", detail, target, settings);
+
+    target.width = min(numLeds, (uint16_t)RENDER_BENCHMARK_WIDTH);
+    snprintf(detail, sizeof(detail), "%u wide", target.width);
+    timeEffect(out, "plasma", detail, target, settings);
+    timeEffect(out, "flow", detail, target, settings);
+    timeEffect(out, "text", detail, target, settings);
+
+    free(table);
+    free(heat);
+}
+
+/**
+ * Runs every case and prints one line per case.
+ *
+ * @param out Where to write the results, eg: Serial or a web response.
+ * @param numLeds Pixels per frame, normally the strip length.
+ */
+void runRenderBenchmark(Print &out, uint16_t numLeds)
+{
+    CRGB *pixels = (CRGB *)malloc(numLeds * sizeof(CRGB));
+    PaletteLut *lut = new PaletteLut();
+    if (!pixels || !lut)
+    {
+        out.println("Not enough memory for the benchmark");
+        free(pixels);
+        delete lut;
+        return;
+    }
+
+    CRGBPalette16 palette = RainbowColors_p;
+    const uint8_t brightness = 200;
+    out.printf("Render benchmark: %u LEDs, %u frames per case\n", numLeds, RENDER_BENCHMARK_FRAMES);
+
+    // Palette fill, interpolating every pixel
+    uint32_t start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        uint8_t colorIndex = frame;
+        for (uint16_t i = 0; i < numLeds; i++)
+        {
+            pixels[i] = ColorFromPalette(palette, colorIndex, brightness);
+            colorIndex += 3;
+        }
+    }
+    report(out, "fill: ColorFromPalette", micros() - start);
+
+    // Palette fill from the expanded table
+    lut->build(palette, brightness);
+    start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        uint8_t colorIndex = frame;
+        for (uint16_t i = 0; i < numLeds; i++)
+        {
+            pixels[i] = (*lut)[colorIndex];
+            colorIndex += 3;
+        }
+    }
+    report(out, "fill: palette LUT", micros() - start);
+
+    // What a palette or brightness change costs
+    start = micros();
+    for (uint16_t frame = 0; frame < RENDER_BENCHMARK_FRAMES; frame++)
+    {
+        lut->build(palette, brightness);
+    }
+    report(out, "palette LUT rebuild", micros() - start);
+
+    benchmarkEffects(out, pixels, numLeds, lut);
+    benchmarkEncode(out, pixels, numLeds, brightness);
+
+    free(pixels);
+    delete lut;
+}
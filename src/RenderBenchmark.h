@@ -0,0 +1,21 @@
+#ifndef RENDERBENCHMARK_H
+#define RENDERBENCHMARK_H
+
+#pragma once
+
+#include <Arduino.h>
+
+#define RENDER_BENCHMARK_FRAMES 100
+#define RENDER_BENCHMARK_WIDTH 32 // Canvas width for the 2D effects, a 32x32 panel at 1024 LEDs
+
+/*
+    Times the render kernels in isolation.
+
+    Each case renders RENDER_BENCHMARK_FRAMES frames of numLeds pixels into a
+    scratch buffer on the calling task and reports the average per frame, so
+    before/after numbers for a kernel change come from the same run. The
+    render task keeps running meanwhile, so expect some jitter.
+*/
+void runRenderBenchmark(Print &out, uint16_t numLeds);
+
+#endif
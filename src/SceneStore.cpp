@@ -0,0 +1,329 @@
+#include <LittleFS.h>
+#include "SceneStore.h"
+#include "LightUtils.h"
+
+SceneStore *sceneStore = NULL;
+
+static_assert(sizeof(LightConfig) <= SCENE_CONFIG_SIZE, "LightConfig no longer fits in a scene record");
+
+SceneStore::SceneStore()
+{
+    memset(names, 0, sizeof(names));
+    for (uint16_t i = 0; i < SCENE_HASH_SLOTS; i++)
+    {
+        hashTable[i] = HASH_EMPTY;
+    }
+    mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * Reads every record header in the scene file once and builds the name index.
+ *
+ * @return true if the file was read or doesn't exist yet, false on a read error.
+ */
+bool SceneStore::begin(void)
+{
+    if (!LittleFS.exists(SCENE_FILE))
+    {
+        Serial.println("No scenes stored yet");
+        return true;
+    }
+
+    File file = LittleFS.open(SCENE_FILE, FILE_READ);
+    if (!file)
+    {
+        Serial.println("Failed to open " SCENE_FILE);
+        return false;
+    }
+
+    SceneRecord record;
+    slotCount = 0;
+    while (slotCount < MAX_SCENES && file.read((uint8_t *)&record, sizeof(record)) == sizeof(record))
+    {
+        if (record.used)
+        {
+            record.name[SCENE_NAME_LENGTH - 1] = '\0';
+            strcpy(names[slotCount], record.name);
+            indexInsert(record.name, slotCount);
+            sceneCount++;
+        }
+        slotCount++;
+    }
+    file.close();
+
+    Serial.printf("Loaded scene index: %u scenes in %u slots\n", sceneCount, slotCount);
+    return true;
+}
+
+/**
+ * Stores the configuration under a name, replacing any scene with that name.
+ *
+ * @param name The scene name. Must be shorter than SCENE_NAME_LENGTH.
+ * @param config The configuration to store.
+ * @return true on success.
+ */
+bool SceneStore::save(const char *name, const LightConfig &config)
+{
+    size_t nameLength = strlen(name);
+    if (nameLength == 0 || nameLength >= SCENE_NAME_LENGTH)
+    {
+        Serial.println("Invalid scene name");
+        return false;
+    }
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    int16_t slot = findSlot(name);
+    bool isNew = slot < 0;
+    if (isNew)
+    {
+        // Reuse a deleted slot before growing the file
+        for (uint16_t i = 0; i < slotCount; i++)
+        {
+            if (names[i][0] == '\0')
+            {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0)
+        {
+            if (slotCount == MAX_SCENES)
+            {
+                xSemaphoreGive(mutex);
+                Serial.println("Scene store is full");
+                return false;
+            }
+            slot = slotCount;
+        }
+    }
+
+    SceneRecord record;
+    memset(&record, 0, sizeof(record));
+    record.used = 1;
+    strcpy(record.name, name);
+    record.header = {LIGHT_CONFIG_VERSION, sizeof(LightConfig)};
+    memcpy(record.config, &config, sizeof(config));
+
+    bool ok = writeRecord(slot, record);
+    if (ok && isNew)
+    {
+        strcpy(names[slot], name);
+        indexInsert(name, slot);
+        sceneCount++;
+        if (slot == slotCount)
+        {
+            slotCount++;
+        }
+    }
+
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+/**
+ * Reads a scene's configuration.
+ *
+ * @param name The scene name.
+ * @param config Filled with the stored configuration. Fields newer than the
+ *               scene keep their defaults.
+ * @return true if the scene exists and was read.
+ */
+bool SceneStore::load(const char *name, LightConfig &config)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    int16_t slot = findSlot(name);
+    SceneRecord record;
+    bool ok = slot >= 0 && readRecord(slot, record);
+
+    xSemaphoreGive(mutex);
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    LightConfig loaded;
+    memcpy(&loaded, record.config, lightConfigPayload(record.header));
+    config = loaded;
+    return true;
+}
+
+/**
+ * Loads a scene and applies it to the lights in one step.
+ *
+ * @param name The scene name.
+ * @return true if the scene was found and applied.
+ */
+bool SceneStore::recall(const char *name)
+{
+    LightConfig config;
+    if (!load(name, config))
+    {
+        Serial.printf("Scene '%s' not found\n", name);
+        return false;
+    }
+
+    lightUtils->applyConfig(config);
+    return true;
+}
+
+/**
+ * Deletes a scene. Its slot is reused by the next new scene.
+ *
+ * @param name The scene name.
+ * @return true if the scene existed and was removed.
+ */
+bool SceneStore::remove(const char *name)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    int16_t slot = findSlot(name);
+    bool ok = false;
+    if (slot >= 0)
+    {
+        SceneRecord record;
+        memset(&record, 0, sizeof(record));
+        ok = writeRecord(slot, record);
+        if (ok)
+        {
+            indexRemove(name);
+            names[slot][0] = '\0';
+            sceneCount--;
+        }
+    }
+
+    xSemaphoreGive(mutex);
+    return ok;
+}
+
+uint16_t SceneStore::count(void)
+{
+    return sceneCount;
+}
+
+String SceneStore::list(void)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    String result;
+    for (uint16_t i = 0; i < slotCount; i++)
+    {
+        if (names[i][0] == '\0')
+        {
+            continue;
+        }
+        if (result.length())
+        {
+            result += ", ";
+        }
+        result += names[i];
+    }
+
+    xSemaphoreGive(mutex);
+    return result;
+}
+
+/**
+ * FNV-1a hash of a scene name.
+ */
+uint32_t SceneStore::hashName(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Finds the record slot for a name. Caller must hold the mutex.
+ *
+ * @return The slot, or -1 if there's no scene with that name.
+ */
+int16_t SceneStore::findSlot(const char *name)
+{
+    uint32_t bucket = hashName(name) & (SCENE_HASH_SLOTS - 1);
+    for (uint16_t probe = 0; probe < SCENE_HASH_SLOTS; probe++)
+    {
+        int16_t slot = hashTable[bucket];
+        if (slot == HASH_EMPTY)
+        {
+            return -1;
+        }
+        if (slot >= 0 && strcmp(names[slot], name) == 0)
+        {
+            return slot;
+        }
+        bucket = (bucket + 1) & (SCENE_HASH_SLOTS - 1);
+    }
+    return -1;
+}
+
+void SceneStore::indexInsert(const char *name, int16_t slot)
+{
+    uint32_t bucket = hashName(name) & (SCENE_HASH_SLOTS - 1);
+    while (hashTable[bucket] >= 0)
+    {
+        bucket = (bucket + 1) & (SCENE_HASH_SLOTS - 1);
+    }
+    hashTable[bucket] = slot;
+}
+
+void SceneStore::indexRemove(const char *name)
+{
+    uint32_t bucket = hashName(name) & (SCENE_HASH_SLOTS - 1);
+    for (uint16_t probe = 0; probe < SCENE_HASH_SLOTS; probe++)
+    {
+        int16_t slot = hashTable[bucket];
+        if (slot == HASH_EMPTY)
+        {
+            return;
+        }
+        if (slot >= 0 && strcmp(names[slot], name) == 0)
+        {
+            // Leave a marker so probes for names further along the chain still find them
+            hashTable[bucket] = HASH_DELETED;
+            return;
+        }
+        bucket = (bucket + 1) & (SCENE_HASH_SLOTS - 1);
+    }
+}
+
+bool SceneStore::writeRecord(uint16_t slot, const SceneRecord &record)
+{
+    // "r+" keeps the other records; it fails if the file doesn't exist yet
+    File file = LittleFS.exists(SCENE_FILE) ? LittleFS.open(SCENE_FILE, "r+") : LittleFS.open(SCENE_FILE, FILE_WRITE);
+    if (!file)
+    {
+        Serial.println("Failed to open " SCENE_FILE " for writing");
+        return false;
+    }
+
+    bool ok = file.seek(slot * sizeof(SceneRecord), SeekSet) &&
+              file.write((const uint8_t *)&record, sizeof(record)) == sizeof(record);
+    file.close();
+
+    if (!ok)
+    {
+        Serial.println("Failed to write scene record");
+    }
+    return ok;
+}
+
+bool SceneStore::readRecord(uint16_t slot, SceneRecord &record)
+{
+    File file = LittleFS.open(SCENE_FILE, FILE_READ);
+    if (!file)
+    {
+        return false;
+    }
+
+    bool ok = file.seek(slot * sizeof(SceneRecord), SeekSet) &&
+              file.read((uint8_t *)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    return ok;
+}
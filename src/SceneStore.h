@@ -0,0 +1,66 @@
+#ifndef SCENESTORE_H
+#define SCENESTORE_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "LightUtils.h"
+
+#define SCENE_FILE "/scenes.bin"
+#define SCENE_NAME_LENGTH 24 // Including the terminator
+#define SCENE_CONFIG_SIZE 96 // Room for LightConfig to grow without changing the record size
+#define MAX_SCENES 256
+#define SCENE_HASH_SLOTS 512 // Power of two, at least twice MAX_SCENES
+
+/*
+    Named lighting presets.
+
+    Scenes are fixed-size records in SCENE_FILE on LittleFS. The name index is
+    held in RAM and hashed, so finding a scene doesn't depend on how many are
+    stored, and recalling one is a single seek and read. A recalled scene is
+    handed to LightUtils::applyConfig(), which switches every field on the same
+    frame and persists it as one blob write.
+*/
+class SceneStore
+{
+private:
+    struct SceneRecord
+    {
+        uint8_t used;
+        char name[SCENE_NAME_LENGTH];
+        LightConfigHeader header;
+        uint8_t config[SCENE_CONFIG_SIZE];
+    };
+
+    char names[MAX_SCENES][SCENE_NAME_LENGTH]; // Empty name means the slot is free
+    int16_t hashTable[SCENE_HASH_SLOTS];       // Record slot, or one of the markers below
+    uint16_t slotCount = 0;                    // Records in the file, used or not
+    uint16_t sceneCount = 0;
+    SemaphoreHandle_t mutex;
+
+    static constexpr int16_t HASH_EMPTY = -1;
+    static constexpr int16_t HASH_DELETED = -2;
+
+    static uint32_t hashName(const char *name);
+    int16_t findSlot(const char *name);
+    void indexInsert(const char *name, int16_t slot);
+    void indexRemove(const char *name);
+    bool writeRecord(uint16_t slot, const SceneRecord &record);
+    bool readRecord(uint16_t slot, SceneRecord &record);
+
+public:
+    SceneStore();
+    bool begin(void); // Build the in-RAM index from SCENE_FILE
+
+    bool save(const char *name, const LightConfig &config);
+    bool load(const char *name, LightConfig &config);
+    bool recall(const char *name); // Load and apply to lightUtils
+    bool remove(const char *name);
+
+    uint16_t count(void);
+    String list(void); // Comma separated scene names, for display
+};
+
+extern SceneStore *sceneStore;
+
+#endif
@@ -0,0 +1,206 @@
+#include "SegmentPool.h"
+#include "utilities/PreferencesManager.h"
+
+static_assert(offsetof(SegmentConfig, effect) == SEGMENT_V2_BYTES, "Stored segments before the effect name no longer line up");
+
+/**
+ * Reads every stored slot. Missing or short slots stay free. Slots stored
+ * before the fire parameters or the effect name keep their defaults for
+ * those; only the old fields are copied, since the padding at the end of
+ * the first layout is where cooling now lives.
+ */
+void SegmentPool::load(void)
+{
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+    {
+        char key[8];
+        snprintf(key, sizeof(key), SEGMENT_KEY_PREFIX "%u", i);
+
+        SegmentConfig segment;
+        uint8_t stored[sizeof(SegmentConfig)];
+        size_t length = PreferencesManager::getBytes(key, stored, sizeof(stored));
+        size_t fields = 0;
+        if (length == sizeof(SegmentConfig))
+        {
+            fields = length;
+        }
+        else if (length == SEGMENT_V2_BYTES)
+        {
+            fields = offsetof(SegmentConfig, effect);
+        }
+        else if (length == SEGMENT_V1_BYTES)
+        {
+            fields = offsetof(SegmentConfig, cooling);
+        }
+        if (fields)
+        {
+            memcpy(&segment, stored, fields);
+            segment.name[SEGMENT_NAME_LENGTH - 1] = '\0';
+            segment.effect[SEGMENT_EFFECT_NAME_LENGTH - 1] = '\0';
+            slots[i] = segment;
+        }
+    }
+    changed = true;
+}
+
+/**
+ * Adds a segment, or updates the one with the same name.
+ *
+ * @return false if the name is empty, the segment is empty, it overlaps
+ *         another segment or the pool is full.
+ */
+bool SegmentPool::set(const SegmentConfig &segment)
+{
+    if (!segment.name[0] || !segment.length)
+    {
+        return false;
+    }
+
+    uint32_t end = (uint32_t)segment.start + segment.length;
+
+    portENTER_CRITICAL(&mux);
+    int8_t slot = findSlot(segment.name);
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+    {
+        const SegmentConfig &other = slots[i];
+        if (i == slot || !other.length)
+        {
+            continue;
+        }
+        if (segment.start < other.start + other.length && other.start < end)
+        {
+            portEXIT_CRITICAL(&mux);
+            Serial.printf("Segment '%s' overlaps '%s'\n", segment.name, other.name);
+            return false;
+        }
+    }
+    if (slot < 0)
+    {
+        slot = findSlot("");
+    }
+    if (slot >= 0)
+    {
+        slots[slot] = segment;
+        slots[slot].name[SEGMENT_NAME_LENGTH - 1] = '\0';
+        slots[slot].effect[SEGMENT_EFFECT_NAME_LENGTH - 1] = '\0';
+        changed = true;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (slot < 0)
+    {
+        Serial.println("Segment pool is full");
+        return false;
+    }
+    saveSlot(slot);
+    return true;
+}
+
+bool SegmentPool::remove(const char *name)
+{
+    portENTER_CRITICAL(&mux);
+    int8_t slot = findSlot(name);
+    if (slot >= 0)
+    {
+        slots[slot] = SegmentConfig();
+        changed = true;
+    }
+    portEXIT_CRITICAL(&mux);
+
+    if (slot < 0)
+    {
+        return false;
+    }
+    saveSlot(slot);
+    return true;
+}
+
+void SegmentPool::clear(void)
+{
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+    {
+        portENTER_CRITICAL(&mux);
+        bool used = slots[i].length != 0;
+        slots[i] = SegmentConfig();
+        changed = true;
+        portEXIT_CRITICAL(&mux);
+
+        if (used)
+        {
+            saveSlot(i);
+        }
+    }
+}
+
+/**
+ * Copies the used segments, sorted by their first pixel.
+ *
+ * @param out Room for MAX_SEGMENTS.
+ * @return The number of segments copied.
+ */
+uint8_t SegmentPool::list(SegmentConfig *out)
+{
+    uint8_t count = 0;
+
+    portENTER_CRITICAL(&mux);
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+    {
+        if (!slots[i].length)
+        {
+            continue;
+        }
+        // Insertion sort, there are only MAX_SEGMENTS
+        uint8_t j = count++;
+        while (j > 0 && out[j - 1].start > slots[i].start)
+        {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = slots[i];
+    }
+    portEXIT_CRITICAL(&mux);
+
+    return count;
+}
+
+/**
+ * Render task side of list(). Skips the copy when nothing has changed.
+ *
+ * @return true if out and count were updated.
+ */
+bool SegmentPool::take(SegmentConfig *out, uint8_t &count)
+{
+    if (!changed)
+    {
+        return false;
+    }
+    changed = false;
+    count = list(out);
+    return true;
+}
+
+// Call with mux held
+int8_t SegmentPool::findSlot(const char *name)
+{
+    for (uint8_t i = 0; i < MAX_SEGMENTS; i++)
+    {
+        bool used = slots[i].length != 0;
+        if (name[0] ? (used && strcmp(slots[i].name, name) == 0) : !used)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SegmentPool::saveSlot(uint8_t slot)
+{
+    char key[8];
+    snprintf(key, sizeof(key), SEGMENT_KEY_PREFIX "%u", slot);
+
+    portENTER_CRITICAL(&mux);
+    SegmentConfig segment = slots[slot];
+    portEXIT_CRITICAL(&mux);
+
+    PreferencesManager::setBytes(key, &segment, sizeof(segment));
+}
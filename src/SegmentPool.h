@@ -0,0 +1,69 @@
+#ifndef SEGMENTPOOL_H
+#define SEGMENTPOOL_H
+
+#pragma once
+
+#include <Arduino.h>
+#include "configuration.h"
+
+#define MAX_SEGMENTS 8
+#define SEGMENT_NAME_LENGTH 16 // Including the terminator
+#define SEGMENT_KEY_PREFIX "seg" // Stored one slot per key: seg0, seg1, ...
+#define SEGMENT_V1_BYTES 26      // Stored size before the fire parameters were added
+#define SEGMENT_V2_BYTES 28      // Stored size before the effect name was added
+#define SEGMENT_EFFECT_NAME_LENGTH 12 // Including the terminator, same as LIGHT_EFFECT_NAME_LENGTH
+
+/*
+    One zone of the strip with its own effect.
+
+    start and length are in logical pixels, after the pixel map, so a segment
+    can cover a physical row whichever way it's wired.
+*/
+struct SegmentConfig
+{
+    char name[SEGMENT_NAME_LENGTH] = "";
+    uint16_t start = 0;
+    uint16_t length = 0; // 0 marks a free slot
+    uint8_t program = 1; // Palette, same numbering as LightConfig::program
+    uint8_t speed = 1;   // Palette steps per frame
+    uint8_t sin = 0;
+    bool reverse = false;
+    bool fire = false;
+    // Added after SEGMENT_V1_BYTES
+    uint8_t cooling = DEFAULT_COOLING;
+    uint8_t sparking = DEFAULT_SPARKING;
+    uint8_t columns = 1;
+    // Added after SEGMENT_V2_BYTES
+    char effect[SEGMENT_EFFECT_NAME_LENGTH] = ""; // Registered effect to show, empty for the fire flag
+};
+
+/*
+    Fixed pool of named segments.
+
+    The web and config file side edits the pool under a spinlock; the render
+    task copies it, sorted by start, at the start of a frame only when it has
+    changed. Segments may not overlap, so a frame renders every pixel once
+    whatever the number of segments.
+*/
+class SegmentPool
+{
+private:
+    SegmentConfig slots[MAX_SEGMENTS];
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    volatile bool changed = true;
+
+    int8_t findSlot(const char *name);
+    void saveSlot(uint8_t slot);
+
+public:
+    void load(void); // Read the stored segments, at boot
+
+    bool set(const SegmentConfig &segment); // Add, or replace the segment with the same name
+    bool remove(const char *name);
+    void clear(void);
+
+    uint8_t list(SegmentConfig *out);     // Copies the used segments, sorted by start
+    bool take(SegmentConfig *out, uint8_t &count); // Render task: list() if anything changed since the last take()
+};
+
+#endif
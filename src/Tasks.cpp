@@ -4,6 +4,7 @@
 #include <WiFi.h>
 #include <WiFiMulti.h>
 #include "NovaIO.h"
+#include "utilities/PreferencesManager.h"
 #include <esp_heap_caps.h>
 
 // Using REPORT_TASK_INTERVAL from configuration.h
@@ -65,6 +66,8 @@ void updateTaskStats(const char *name, UBaseType_t watermark, BaseType_t coreId)
     // TaskAmbient has been removed
     else if (strcmp(name, "LightUtils") == 0)
         initialStack = 3 * 1024;
+    else if (strcmp(name, "LedOutput") == 0)
+        initialStack = 3 * 1024;
     else if (strcmp(name, "I2CMonitor") == 0)
         initialStack = 3 * 1024; // Updated to match new size
     else if (strcmp(name, "TaskMonitor") == 0)
@@ -123,6 +126,66 @@ void TaskMonitor(void *pvParameters)
         float fragmentation = 100.0f * (1.0f - (float)heapInfo.largest_free_block / heapInfo.total_free_bytes);
         Serial.printf("Heap Fragmentation: %.2f%%\n", fragmentation);
 
+        // Print preference journal statistics
+        PreferencesManager::JournalStats journalStats = PreferencesManager::getJournalStats();
+        Serial.println("\n=== Preferences Journal ===");
+        Serial.printf("Writes Requested: %u\n", journalStats.writesRequested);
+        Serial.printf("Writes Avoided: %u\n", journalStats.writesAvoided);
+        Serial.printf("Commits: %u (%u keys, %u bytes)\n", journalStats.commits, journalStats.keysCommitted, journalStats.bytesCommitted);
+
+        // Print light command queue statistics
+        Serial.println("\n=== Light Commands ===");
+        Serial.printf("Posted: %u\n", lightUtils->getCommandQueue().getPosted());
+        Serial.printf("Coalesced: %u\n", lightUtils->getCommandQueue().getCoalesced());
+
+        // Print frame pacing statistics
+        FrameScheduler::FrameStats frameStats = lightUtils->getFrameStats();
+        Serial.println("\n=== Frame Scheduler ===");
+        Serial.printf("Target Rate: %u fps\n", frameStats.rate);
+        Serial.printf("Frames: %u\n", frameStats.frames);
+        Serial.printf("Missed Deadlines: %u (%u frames dropped)\n", frameStats.missedDeadlines, frameStats.droppedFrames);
+        Serial.printf("Render Time: last %u us, avg %u us, max %u us\n", frameStats.lastFrameUs, frameStats.avgFrameUs, frameStats.maxFrameUs);
+        Serial.printf("Palette Blend: %u%%\n", lightUtils->getBlendProgress() * 100 / 255);
+        Serial.printf("Output Time: last %u us, max %u us (%u frames)\n", lightUtils->getPipeline().getLastOutputUs(), lightUtils->getPipeline().getMaxOutputUs(), lightUtils->getPipeline().getOutputFrames());
+        uint32_t skipped = lightUtils->getPipeline().getSkippedFrames();
+        Serial.printf("Unchanged Frames Skipped: %u, saved %llu ms SPI, %llu ms CPU\n", skipped,
+                      (uint64_t)skipped * lightUtils->getFrameWireUs() / 1000, lightUtils->getPipeline().getSavedOutputUs() / 1000);
+
+        Serial.println("\n=== LED Memory ===");
+        const StripLayout &layout = lightUtils->getStripLayout();
+        for (uint8_t i = 0; i < MAX_STRIPS; i++)
+        {
+            if (layout.leds[i])
+            {
+                const ColorSettings &color = layout.color[i];
+                Serial.printf("Strip %u: %u LEDs, %u bytes, gamma %.1f, correction #%06X, dither %u bits\n", i + 1, layout.leds[i], lightUtils->getStripMemory(i),
+                              color.gamma, color.correction, lightUtils->getDitherBits(i));
+            }
+        }
+        Serial.printf("Arena: %u bytes for %u LEDs\n", lightUtils->getArenaUsed(), lightUtils->getNumberOfLeds());
+        PixelMap &pixelMap = lightUtils->getPixelMap();
+        Serial.printf("Pixel Map: %u pixels from %s (%u builds)\n", pixelMap.getLength(), pixelMap.getSource(), pixelMap.getRebuilds());
+
+        Serial.println("\n=== Power ===");
+        PowerLimiter &power = lightUtils->getPowerLimiter();
+        for (uint8_t i = 0; i < MAX_STRIPS; i++)
+        {
+            if (!layout.leds[i])
+            {
+                continue;
+            }
+            if (power.getBudget(i))
+            {
+                Serial.printf("Strip %u: %u mA estimated, %u mA budget, brightness scaled to %u%%\n", i + 1, power.getEstimatedMa(i), power.getBudget(i),
+                              (power.getScale(i) * 100) / 255);
+            }
+            else
+            {
+                Serial.printf("Strip %u: %u mA estimated, no budget\n", i + 1, power.getEstimatedMa(i));
+            }
+        }
+        Serial.printf("Limited Frames: %u\n", power.getLimitedFrames());
+
         // Monitor our own stack
         uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
         updateTaskStats(pcTaskName, uxHighWaterMark, xPortGetCoreID());
@@ -146,8 +209,31 @@ void TaskLightUtils(void *pvParameters)
     Serial.println("TaskLightUtils is running");
     while (1)
     {
+        // Blocks until the next frame deadline, so no extra delay is needed here
         lightUtils->loop();
-        vTaskDelay(pdMS_TO_TICKS(3));
+
+        if (millis() - lastExecutionTime >= REPORT_TASK_INTERVAL)
+        {
+            uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
+            updateTaskStats(pcTaskName, uxHighWaterMark, xPortGetCoreID());
+            lastExecutionTime = millis();
+        }
+    }
+}
+
+void TaskLedOutput(void *pvParameters)
+{
+    (void)pvParameters;
+    UBaseType_t uxHighWaterMark;
+    TaskHandle_t xTaskHandle = xTaskGetCurrentTaskHandle();
+    const char *pcTaskName = pcTaskGetName(xTaskHandle);
+    uint32_t lastExecutionTime = 0;
+
+    Serial.println("TaskLedOutput is running");
+    while (1)
+    {
+        // Blocks until the render task submits a frame
+        lightUtils->outputLoop();
 
         if (millis() - lastExecutionTime >= REPORT_TASK_INTERVAL)
         {
@@ -181,6 +267,9 @@ void TaskWeb(void *pvParameters)
         }
         
         webLoop();
+
+        // Commit any settings the UI changed once the writes have settled
+        PreferencesManager::loop();
         
         // Increased delay to give more time for network stack processing
         vTaskDelay(pdMS_TO_TICKS(20));
@@ -240,9 +329,21 @@ void taskSetup()
 
     // TaskAmbient has been removed
 
-    Serial.println("Create LightUtils");
-    xTaskCreate(&TaskLightUtils, "LightUtils", 3 * 1024, NULL, 3, NULL);
-    Serial.println("Create LightUtils - Done");
+    // Without LED buffers the render task would block forever waiting for one
+    if (lightUtils->getNumberOfLeds())
+    {
+        Serial.println("Create LightUtils");
+        xTaskCreatePinnedToCore(&TaskLightUtils, "LightUtils", 3 * 1024, NULL, 3, NULL, RENDER_CORE);
+        Serial.println("Create LightUtils - Done");
+
+        Serial.println("Create LedOutput");
+        xTaskCreatePinnedToCore(&TaskLedOutput, "LedOutput", 3 * 1024, NULL, 3, NULL, OUTPUT_CORE);
+        Serial.println("Create LedOutput - Done");
+    }
+    else
+    {
+        Serial.println("No LED buffers, not creating LightUtils and LedOutput");
+    }
 
     Serial.println("Create TaskI2CMonitor");
     xTaskCreate(&TaskI2CMonitor, "I2CMonitor", 3 * 1024, NULL, 1, NULL);
@@ -7,6 +7,7 @@
 void taskSetup();
 
 void TaskLightUtils(void *pvParameters);
+void TaskLedOutput(void *pvParameters);
 // TaskEnable has been removed
 void TaskModes(void *pvParameters);
 void TaskWeb(void *pvParameters);
@@ -7,6 +7,10 @@
 #include <ESPUI.h>
 #include <Arduino.h>
 #include "LightUtils.h"
+#include "SceneStore.h"
+#include "ConfigFile.h"
+#include "RenderBenchmark.h"
+#include <StreamString.h>
 #include "utilities/PreferencesManager.h"
 #include "freertos/semphr.h"
 #include <Preferences.h>
@@ -198,6 +202,7 @@ void handleSystemCommand(AsyncWebServerRequest *request, const JsonVariant &json
 
         // Delay to allow response to be sent
         delay(500);
+        PreferencesManager::flush();
         ESP.restart();
         return;
     }
@@ -220,6 +225,206 @@ void handleSystemCommand(AsyncWebServerRequest *request, const JsonVariant &json
     xSemaphoreGive(apiMutex);
 }
 
+// Streams the running configuration in the /config.json format, so one
+// configured unit can be used to provision the rest.
+void handleConfigExport(AsyncWebServerRequest *request) {
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->addHeader("Content-Disposition", "attachment; filename=config.json");
+    exportConfig(*response);
+    request->send(response);
+}
+
+// Adds or updates a segment from form parameters. Missing parameters keep
+// their defaults.
+void handleSegmentSet(AsyncWebServerRequest *request) {
+    if (!request->hasParam("name", true)) {
+        request->send(400, "text/plain", "name is required");
+        return;
+    }
+    if (request->getParam("name", true)->value().length() >= SEGMENT_NAME_LENGTH) {
+        request->send(400, "text/plain", "name is too long");
+        return;
+    }
+
+    SegmentConfig segment;
+    strlcpy(segment.name, request->getParam("name", true)->value().c_str(), sizeof(segment.name));
+    if (request->hasParam("start", true)) segment.start = constrain((long)request->getParam("start", true)->value().toInt(), 0L, (long)MAX_LEDS);
+    if (request->hasParam("length", true)) segment.length = constrain((long)request->getParam("length", true)->value().toInt(), 0L, (long)MAX_LEDS);
+    if (request->hasParam("program", true)) segment.program = request->getParam("program", true)->value().toInt();
+    if (request->hasParam("speed", true)) segment.speed = constrain((long)request->getParam("speed", true)->value().toInt(), 0L, 255L);
+    if (request->hasParam("sin", true)) segment.sin = constrain((long)request->getParam("sin", true)->value().toInt(), 0L, 32L);
+    if (request->hasParam("reverse", true)) segment.reverse = request->getParam("reverse", true)->value().toInt() != 0;
+    if (request->hasParam("fire", true)) segment.fire = request->getParam("fire", true)->value().toInt() != 0;
+    if (request->hasParam("effect", true)) {
+        const String &effect = request->getParam("effect", true)->value();
+        if (effect.length() >= SEGMENT_EFFECT_NAME_LENGTH || (effect.length() && !EffectRegistry::find(effect.c_str()))) {
+            request->send(400, "text/plain", "No such effect");
+            return;
+        }
+        strlcpy(segment.effect, effect.c_str(), sizeof(segment.effect));
+    }
+    if (request->hasParam("cooling", true)) segment.cooling = constrain((long)request->getParam("cooling", true)->value().toInt(), 0L, 255L);
+    if (request->hasParam("sparking", true)) segment.sparking = constrain((long)request->getParam("sparking", true)->value().toInt(), 0L, 255L);
+    if (request->hasParam("columns", true)) segment.columns = constrain((long)request->getParam("columns", true)->value().toInt(), 1L, 255L);
+
+    if (lightUtils->getSegments().set(segment)) {
+        request->send(200, "text/plain", "OK");
+    } else {
+        request->send(409, "text/plain", "Segment is empty, overlaps another or the pool is full");
+    }
+}
+
+void handleSegmentRemove(AsyncWebServerRequest *request) {
+    if (!request->hasParam("name")) {
+        request->send(400, "text/plain", "name is required");
+        return;
+    }
+    if (request->getParam("name")->value().length() >= SEGMENT_NAME_LENGTH) {
+        request->send(400, "text/plain", "name is too long");
+        return;
+    }
+    if (lightUtils->getSegments().remove(request->getParam("name")->value().c_str())) {
+        request->send(200, "text/plain", "OK");
+    } else {
+        request->send(404, "text/plain", "No such segment");
+    }
+}
+
+// Adds pixels to an overlay layer, creating it on top of the stack.
+void handleLayerSet(AsyncWebServerRequest *request) {
+    if (!request->hasParam("name", true) || !request->hasParam("start", true) || !request->hasParam("end", true)) {
+        request->send(400, "text/plain", "name, start and end are required");
+        return;
+    }
+    if (request->getParam("name", true)->value().length() >= LAYER_NAME_LENGTH) {
+        request->send(400, "text/plain", "name is too long");
+        return;
+    }
+    if (request->getParam("name", true)->value() == PROTECTED_LAYER) {
+        request->send(403, "text/plain", "The protected layer belongs to protectLedRange()");
+        return;
+    }
+
+    uint16_t start = request->getParam("start", true)->value().toInt();
+    uint16_t end = request->getParam("end", true)->value().toInt();
+    uint32_t color = 0xFFFFFF;
+    if (request->hasParam("color", true)) {
+        const char *hex = request->getParam("color", true)->value().c_str();
+        color = strtoul(hex + (hex[0] == '#'), NULL, 16) & 0xFFFFFF;
+    }
+    LayerBlend blend = LayerBlend::Replace;
+    if (request->hasParam("blend", true)) {
+        const String &mode = request->getParam("blend", true)->value();
+        if (mode == "add") blend = LayerBlend::Add;
+        else if (mode == "alpha") blend = LayerBlend::Alpha;
+        else if (mode != "replace") blend = LayerBlend::Count;
+    }
+    uint8_t alpha = 255;
+    if (request->hasParam("alpha", true)) alpha = constrain((long)request->getParam("alpha", true)->value().toInt(), 0L, 255L);
+
+    if (lightUtils->getLayers().setRange(request->getParam("name", true)->value().c_str(), start, end, CRGB(color), blend, alpha)) {
+        request->send(200, "text/plain", "OK");
+    } else {
+        request->send(409, "text/plain", "Bad range or blend, or the layer stack is full");
+    }
+}
+
+void handleLayerRemove(AsyncWebServerRequest *request) {
+    // No clearing the whole stack from here: the protected LEDs are a layer too
+    if (!request->hasParam("name")) {
+        request->send(400, "text/plain", "name is required");
+        return;
+    }
+    if (request->getParam("name")->value().length() >= LAYER_NAME_LENGTH) {
+        request->send(400, "text/plain", "name is too long");
+        return;
+    }
+    if (request->getParam("name")->value() == PROTECTED_LAYER) {
+        request->send(403, "text/plain", "The protected layer belongs to protectLedRange()");
+        return;
+    }
+    if (lightUtils->getLayers().remove(request->getParam("name")->value().c_str())) {
+        request->send(200, "text/plain", "OK");
+    } else {
+        request->send(404, "text/plain", "No such layer");
+    }
+}
+
+void handleLayerList(AsyncWebServerRequest *request) {
+    char names[MAX_LAYERS * LAYER_NAME_LENGTH];
+    lightUtils->getLayers().list(names, sizeof(names));
+    request->send(200, "text/plain", names);
+}
+
+// The benchmark takes seconds on long strips, far too long for the async_tcp
+// task. It runs on a task of its own into a fresh buffer, which is swapped in
+// when it's done. GET picks the report up afterwards.
+static SemaphoreHandle_t benchmarkMutex = NULL; // Guards the two below
+static StreamString *benchmarkReport = NULL;
+static bool benchmarkRunning = false;
+
+static void TaskRenderBenchmark(void *parameter) {
+    StreamString *report = new StreamString();
+    runRenderBenchmark(*report, lightUtils->getNumberOfLeds());
+    Serial.print(*report);
+
+    xSemaphoreTake(benchmarkMutex, portMAX_DELAY);
+    StreamString *previous = benchmarkReport;
+    benchmarkReport = report;
+    benchmarkRunning = false;
+    xSemaphoreGive(benchmarkMutex);
+
+    delete previous;
+    vTaskDelete(NULL);
+}
+
+// Starts timing the render kernels
+void handleRenderBenchmarkStart(AsyncWebServerRequest *request) {
+    xSemaphoreTake(benchmarkMutex, portMAX_DELAY);
+    bool running = benchmarkRunning;
+    benchmarkRunning = true;
+    xSemaphoreGive(benchmarkMutex);
+
+    if (running) {
+        request->send(409, "text/plain", "A benchmark is already running");
+        return;
+    }
+    if (xTaskCreate(&TaskRenderBenchmark, "RenderBenchmark", 4 * 1024, NULL, 1, NULL) != pdPASS) {
+        xSemaphoreTake(benchmarkMutex, portMAX_DELAY);
+        benchmarkRunning = false;
+        xSemaphoreGive(benchmarkMutex);
+        request->send(500, "text/plain", "Couldn't start the benchmark task");
+        return;
+    }
+    request->send(202, "text/plain", "Benchmark started, GET /api/benchmark for the results");
+}
+
+// Serves the report of the last benchmark run
+void handleRenderBenchmark(AsyncWebServerRequest *request) {
+    xSemaphoreTake(benchmarkMutex, portMAX_DELAY);
+    bool running = benchmarkRunning;
+    String report = benchmarkReport ? String(*benchmarkReport) : String();
+    xSemaphoreGive(benchmarkMutex);
+
+    if (running) {
+        request->send(202, "text/plain", "Benchmark still running");
+        return;
+    }
+    if (report.length() == 0) {
+        request->send(404, "text/plain", "No benchmark run yet, POST /api/benchmark to start one");
+        return;
+    }
+    request->send(200, "text/plain", report);
+}
+
+// Recompiles the pixel map after a new /pixelmap.json has been uploaded.
+void handlePixelMapReload(AsyncWebServerRequest *request) {
+    lightUtils->rebuildPixelMap();
+    char body[64];
+    snprintf(body, sizeof(body), "{\"source\":\"%s\"}", lightUtils->getPixelMap().getSource());
+    request->send(200, "application/json", body);
+}
+
 // UI control variables
 uint16_t status;
 uint16_t controlMillis;
@@ -237,8 +442,26 @@ uint16_t lightingFireSwitch;
 uint16_t lightingLocalDisable;
 uint16_t lightingAuto;
 uint16_t lightingAutoTime;
+uint16_t lightingBlendTime;
+uint16_t lightingFadeTime;
+uint16_t lightingFadeCurveSelect;
+uint16_t lightingFireCooling;
+uint16_t lightingFireSparking;
+uint16_t lightingFireColumns;
+uint16_t lightingEffectSelect;
+uint16_t lightingCircularArms;
+uint16_t lightingCircularSpin;
+uint16_t lightingText;
+uint16_t lightingParticleCap;
 uint16_t lightingReverseSecondRow;
 
+// Scene control variables
+uint16_t sceneNameText;
+uint16_t sceneSaveButton;
+uint16_t sceneRecallButton;
+uint16_t sceneDeleteButton;
+uint16_t sceneListLabel;
+
 // Fog control variables have been removed
 
 // Manual control variables
@@ -268,6 +491,38 @@ void slider(Control *sender, int type)
     {
         lightUtils->setCfgAutoTime(sender->value.toInt());
     }
+    else if (sender->id == lightingBlendTime)
+    {
+        lightUtils->setCfgBlendTime(sender->value.toInt());
+    }
+    else if (sender->id == lightingFadeTime)
+    {
+        lightUtils->setCfgFadeTime(sender->value.toInt());
+    }
+    else if (sender->id == lightingFireCooling)
+    {
+        lightUtils->setCfgFire(sender->value.toInt(), lightUtils->getCfgFireSparking(), lightUtils->getCfgFireColumns());
+    }
+    else if (sender->id == lightingFireSparking)
+    {
+        lightUtils->setCfgFire(lightUtils->getCfgFireCooling(), sender->value.toInt(), lightUtils->getCfgFireColumns());
+    }
+    else if (sender->id == lightingFireColumns)
+    {
+        lightUtils->setCfgFire(lightUtils->getCfgFireCooling(), lightUtils->getCfgFireSparking(), sender->value.toInt());
+    }
+    else if (sender->id == lightingCircularArms)
+    {
+        lightUtils->setCfgCircularArms(sender->value.toInt());
+    }
+    else if (sender->id == lightingCircularSpin)
+    {
+        lightUtils->setCfgCircularSpin(sender->value.toInt());
+    }
+    else if (sender->id == lightingParticleCap)
+    {
+        lightUtils->setCfgParticleCap(sender->value.toInt());
+    }
     // Fog-related callbacks have been removed
     else
     {
@@ -275,9 +530,80 @@ void slider(Control *sender, int type)
     }
 }
 
+void textCallback(Control *sender, int type)
+{
+    // The scene name is read back from the control when a scene button is pressed
+    if (sender->id == lightingText)
+    {
+        lightUtils->setCfgText(sender->value.c_str());
+    }
+}
+
+// Shows the running configuration in the lighting controls, eg: after a
+// scene has replaced it
+static void refreshLightingControls(void)
+{
+    LightConfig config = lightUtils->getConfig();
+    ESPUI.updateControlValue(lightingBrightnessSlider, String(config.brightness));
+    ESPUI.updateControlValue(lightingProgramSelect, String(config.program));
+    ESPUI.updateControlValue(lightingUpdatesSlider, String(config.updates));
+    ESPUI.updateControlValue(lightingSinSlider, String(config.sin));
+    ESPUI.updateControlValue(lightingReverseSwitch, String(config.reverse));
+    ESPUI.updateControlValue(lightingFireSwitch, String(config.fire));
+    ESPUI.updateControlValue(lightingFireCooling, String(config.fireCooling));
+    ESPUI.updateControlValue(lightingFireSparking, String(config.fireSparking));
+    ESPUI.updateControlValue(lightingFireColumns, String(config.fireColumns));
+    ESPUI.updateControlValue(lightingLocalDisable, String(config.localDisable));
+    ESPUI.updateControlValue(lightingAuto, String(config.autoLight));
+    ESPUI.updateControlValue(lightingAutoTime, String(config.autoTime));
+    ESPUI.updateControlValue(lightingBlendTime, String(config.blendTime));
+    ESPUI.updateControlValue(lightingFadeTime, String(config.fadeTime));
+    ESPUI.updateControlValue(lightingFadeCurveSelect, String(config.fadeCurve));
+    ESPUI.updateControlValue(lightingEffectSelect, config.effect[0] ? String(config.effect) : String("default"));
+    ESPUI.updateControlValue(lightingCircularArms, String(config.circularArms));
+    ESPUI.updateControlValue(lightingCircularSpin, String(config.circularSpin));
+    ESPUI.updateControlValue(lightingText, String(config.text));
+    ESPUI.updateControlValue(lightingParticleCap, String(config.particleCap));
+    ESPUI.updateControlValue(lightingReverseSecondRow, String(config.reverseSecondRow));
+}
+
 void buttonCallback(Control *sender, int type)
 {
     // All button callbacks related to Star and StarSequence have been removed
+
+    if (type != B_UP)
+    {
+        return;
+    }
+
+    String sceneName = ESPUI.getControl(sceneNameText)->value;
+    sceneName.trim();
+
+    bool ok = false;
+    if (sender->id == sceneSaveButton)
+    {
+        ok = sceneStore->save(sceneName.c_str(), lightUtils->getConfig());
+    }
+    else if (sender->id == sceneRecallButton)
+    {
+        ok = sceneStore->recall(sceneName.c_str());
+        if (ok)
+        {
+            refreshLightingControls();
+        }
+    }
+    else if (sender->id == sceneDeleteButton)
+    {
+        ok = sceneStore->remove(sceneName.c_str());
+    }
+    else
+    {
+        Serial.println("Unknown button");
+        return;
+    }
+
+    Serial.printf("Scene '%s': %s\n", sceneName.c_str(), ok ? "OK" : "Failed");
+    ESPUI.updateLabel(sceneListLabel, sceneStore->list());
 }
 
 void switchExample(Control *sender, int value)
@@ -312,6 +638,7 @@ void switchExample(Control *sender, int value)
             // PreferencesManager::clear();
             // PreferencesManager::save();
             delay(50);
+            PreferencesManager::flush();
             ESP.restart();
         }
     }
@@ -322,6 +649,7 @@ void switchExample(Control *sender, int value)
             // Todo:
             //    - Give the user a chance to cancel the reboot.
             Serial.println("Rebooting device from web switch...");
+            PreferencesManager::flush();
             delay(50);
             ESP.restart();
         }
@@ -357,6 +685,14 @@ void selectExample(Control *sender, int value)
     {
         lightUtils->setCfgProgram(sender->value.toInt());
     }
+    else if (sender->id == lightingEffectSelect)
+    {
+        lightUtils->setCfgEffect(sender->value == "default" ? "" : sender->value.c_str());
+    }
+    else if (sender->id == lightingFadeCurveSelect)
+    {
+        lightUtils->setCfgFadeCurve((FadeCurve)sender->value.toInt());
+    }
 }
 
 void webSetup()
@@ -364,6 +700,7 @@ void webSetup()
     // Add tabs
     uint16_t mainTab = ESPUI.addControl(ControlType::Tab, "Main", "Main");
     uint16_t lightingTab = ESPUI.addControl(ControlType::Tab, "Lighting", "Lighting");
+    uint16_t scenesTab = ESPUI.addControl(ControlType::Tab, "Scenes", "Scenes");
     uint16_t sysInfoTab = ESPUI.addControl(ControlType::Tab, "System Info", "System Info");
     uint16_t resetTab = ESPUI.addControl(ControlType::Tab, "Reset", "Reset");
 
@@ -418,6 +755,15 @@ void webSetup()
 
     lightingReverseSwitch = ESPUI.addControl(ControlType::Switcher, "Reverse", String(lightUtils->getCfgReverse()), ControlColor::Alizarin, lightingTab, &switchExample);
     lightingFireSwitch = ESPUI.addControl(ControlType::Switcher, "Fire", String(lightUtils->getCfgFire()), ControlColor::Alizarin, lightingTab, &switchExample);
+    lightingFireCooling = ESPUI.addControl(ControlType::Slider, "Fire Cooling", String(lightUtils->getCfgFireCooling()), ControlColor::Alizarin, lightingFireSwitch, &slider);
+    ESPUI.addControl(Min, "", "20", None, lightingFireCooling);
+    ESPUI.addControl(Max, "", "100", None, lightingFireCooling);
+    lightingFireSparking = ESPUI.addControl(ControlType::Slider, "Fire Sparking", String(lightUtils->getCfgFireSparking()), ControlColor::Alizarin, lightingFireSwitch, &slider);
+    ESPUI.addControl(Min, "", "50", None, lightingFireSparking);
+    ESPUI.addControl(Max, "", "200", None, lightingFireSparking);
+    lightingFireColumns = ESPUI.addControl(ControlType::Slider, "Fire Columns", String(lightUtils->getCfgFireColumns()), ControlColor::Alizarin, lightingFireSwitch, &slider);
+    ESPUI.addControl(Min, "", "1", None, lightingFireColumns);
+    ESPUI.addControl(Max, "", "16", None, lightingFireColumns);
     lightingLocalDisable = ESPUI.addControl(ControlType::Switcher, "Local Disable", String(lightUtils->getCfgLocalDisable()), ControlColor::Alizarin, lightingTab, &switchExample);
 
     lightingAuto = ESPUI.addControl(ControlType::Switcher, "Auto Light Program Selection", String(lightUtils->getCfgAuto()), ControlColor::Alizarin, lightingTab, &switchExample);
@@ -425,9 +771,49 @@ void webSetup()
     ESPUI.addControl(Min, "", "1", None, lightingAutoTime);
     ESPUI.addControl(Max, "", "3600", None, lightingAutoTime);
 
+    lightingBlendTime = ESPUI.addControl(ControlType::Slider, "Palette Blend (ms)", String(lightUtils->getCfgBlendTime()), ControlColor::Alizarin, lightingTab, &slider);
+    ESPUI.addControl(Min, "", "0", None, lightingBlendTime);
+    ESPUI.addControl(Max, "", "10000", None, lightingBlendTime);
+
+    lightingFadeTime = ESPUI.addControl(ControlType::Slider, "Effect Fade (ms)", String(lightUtils->getCfgFadeTime()), ControlColor::Alizarin, lightingTab, &slider);
+    ESPUI.addControl(Min, "", "0", None, lightingFadeTime);
+    ESPUI.addControl(Max, "", "10000", None, lightingFadeTime);
+    lightingFadeCurveSelect = ESPUI.addControl(ControlType::Select, "Effect Fade Curve", String((uint8_t)lightUtils->getCfgFadeCurve()), ControlColor::Alizarin, lightingTab, &selectExample);
+    ESPUI.addControl(ControlType::Option, "Linear", "0", ControlColor::Alizarin, lightingFadeCurveSelect);
+    ESPUI.addControl(ControlType::Option, "Ease In Out", "1", ControlColor::Alizarin, lightingFadeCurveSelect);
+    ESPUI.addControl(ControlType::Option, "Ease In", "2", ControlColor::Alizarin, lightingFadeCurveSelect);
+
+    // Any registered effect, or the fire and circular switches
+    String effect = lightUtils->getCfgEffect();
+    lightingEffectSelect = ESPUI.addControl(ControlType::Select, "Effect", effect.length() ? effect : String("default"), ControlColor::Alizarin, lightingTab, &selectExample);
+    ESPUI.addControl(ControlType::Option, "Default", "default", ControlColor::Alizarin, lightingEffectSelect);
+    for (uint8_t i = 0; i < EffectRegistry::count(); i++)
+    {
+        const char *name = EffectRegistry::get(i)->getName();
+        ESPUI.addControl(ControlType::Option, name, name, ControlColor::Alizarin, lightingEffectSelect);
+    }
+    // Circular mode: repeats around the ring, and rotation in 1/16ths of a palette step per frame
+    lightingCircularArms = ESPUI.addControl(ControlType::Slider, "Circular Arms", String(lightUtils->getCfgCircularArms()), ControlColor::Alizarin, lightingTab, &slider);
+    ESPUI.addControl(Min, "", "1", None, lightingCircularArms);
+    ESPUI.addControl(Max, "", "16", None, lightingCircularArms);
+    lightingCircularSpin = ESPUI.addControl(ControlType::Slider, "Circular Spin", String(lightUtils->getCfgCircularSpin()), ControlColor::Alizarin, lightingTab, &slider);
+    ESPUI.addControl(Min, "", "-64", None, lightingCircularSpin);
+    ESPUI.addControl(Max, "", "64", None, lightingCircularSpin);
+    lightingText = ESPUI.addControl(ControlType::Text, "Scrolling Text", lightUtils->getCfgText(), ControlColor::Alizarin, lightingTab, &textCallback);
+    lightingParticleCap = ESPUI.addControl(ControlType::Slider, "Particle Limit", String(lightUtils->getCfgParticleCap()), ControlColor::Alizarin, lightingTab, &slider);
+    ESPUI.addControl(Min, "", "1", None, lightingParticleCap);
+    ESPUI.addControl(Max, "", String(MAX_PARTICLES), None, lightingParticleCap);
+
     // Add reverse second row toggle
     lightingReverseSecondRow = ESPUI.addControl(ControlType::Switcher, "Reverse Second Row", String(lightUtils->getCfgReverseSecondRow()), ControlColor::Alizarin, lightingTab, &switchExample);
 
+    //--- Scenes Tab ---
+    sceneNameText = ESPUI.addControl(ControlType::Text, "Scene Name", "", ControlColor::Peterriver, scenesTab, &textCallback);
+    sceneSaveButton = ESPUI.addControl(ControlType::Button, "Save Current Look", "Save", ControlColor::Peterriver, scenesTab, &buttonCallback);
+    sceneRecallButton = ESPUI.addControl(ControlType::Button, "Recall Scene", "Recall", ControlColor::Peterriver, scenesTab, &buttonCallback);
+    sceneDeleteButton = ESPUI.addControl(ControlType::Button, "Delete Scene", "Delete", ControlColor::Sunflower, scenesTab, &buttonCallback);
+    sceneListLabel = ESPUI.addControl(ControlType::Label, "Stored Scenes", sceneStore->list(), ControlColor::Peterriver, scenesTab);
+
     // System Info Tab
 
     // Reset tab
@@ -441,6 +827,17 @@ void webSetup()
     ESPUI.begin("NOVA Core");
 
     // API endpoints have been removed
+    benchmarkMutex = xSemaphoreCreateMutex();
+    ESPUI.server->on("/api/config", HTTP_GET, handleConfigExport);
+    ESPUI.server->on("/api/pixelmap/reload", HTTP_POST, handlePixelMapReload);
+    ESPUI.server->on("/api/benchmark", HTTP_GET, handleRenderBenchmark);
+    ESPUI.server->on("/api/benchmark", HTTP_POST, handleRenderBenchmarkStart);
+    ESPUI.server->on("/api/segments", HTTP_POST, handleSegmentSet);
+    ESPUI.server->on("/api/segments", HTTP_DELETE, handleSegmentRemove);
+    ESPUI.server->on("/api/layers", HTTP_GET, handleLayerList);
+    ESPUI.server->on("/api/layers", HTTP_POST, handleLayerSet);
+    ESPUI.server->on("/api/layers", HTTP_DELETE, handleLayerRemove);
+
     // Create API mutex (kept for compatibility with handler functions)
     apiMutex = xSemaphoreCreateMutex();
 }
@@ -24,6 +24,15 @@ void webLoop(void);
 void handleStatusRequest(AsyncWebServerRequest *request);
 void handleLightingCommand(AsyncWebServerRequest *request, JsonVariant &json);
 void handleSystemCommand(AsyncWebServerRequest *request, JsonVariant &json);
+void handleConfigExport(AsyncWebServerRequest *request);
+void handlePixelMapReload(AsyncWebServerRequest *request);
+void handleRenderBenchmark(AsyncWebServerRequest *request);
+void handleRenderBenchmarkStart(AsyncWebServerRequest *request);
+void handleSegmentSet(AsyncWebServerRequest *request);
+void handleSegmentRemove(AsyncWebServerRequest *request);
+void handleLayerSet(AsyncWebServerRequest *request);
+void handleLayerRemove(AsyncWebServerRequest *request);
+void handleLayerList(AsyncWebServerRequest *request);
 
 // API helpers
 void sendJsonResponse(AsyncWebServerRequest *request, JsonDocument &doc);
@@ -6,6 +6,45 @@
 #define APA102_CLOCK 18
 #define APA102_DATA 4
 
+// Second strip, pushed in parallel with the first on the other SPI host.
+#define APA102_2_CLOCK 14
+#define APA102_2_DATA 13
+
+// Default strip lengths. The "strips" section of the config file overrides
+// these at boot; a strip with 0 LEDs isn't fitted.
+#define STRIP1_NUM_LEDS 30
+#define STRIP2_NUM_LEDS 0
+#define MAX_STRIPS 2   // One per free SPI host (HSPI and VSPI)
+#define MAX_LEDS 1024  // Upper limit on the total across all strips
+
+// APA102 output backend: 1 = ESP32 SPI peripherals with DMA, 0 = FastLED's driver
+#define APA102_USE_SPI_DMA 1
+#define APA102_SPI_HOST HSPI_HOST
+#define APA102_2_SPI_HOST VSPI_HOST
+#define APA102_SPI_CLOCK_HZ 10000000 // The FastLED driver ran at 4 MHz
+
+// Frames identical to the last one pushed aren't sent again, except this
+// often so a strip that glitched or was hot-plugged still catches up.
+#define FRAME_KEEPALIVE_MS 1000
+
+// Fire2012 defaults, for the main configuration and new segments.
+// COOLING: How much does the air cool as it rises?
+// Less cooling = taller flames.  More cooling = shorter flames.
+// Default 55, suggested range 20-100
+#define DEFAULT_COOLING 55
+// SPARKING: What chance (out of 255) is there that a new spark will be lit?
+// Higher chance = more roaring fire.  Lower chance = more flickery fire.
+// Default 120, suggested range 50-200.
+#define DEFAULT_SPARKING 120
+
+// Particle effects: how many particles may be alive at once, which bounds
+// their cost per frame. At most MAX_PARTICLES.
+#define DEFAULT_PARTICLE_CAP 64
+
+// Rendering and strip output run as a pipeline on separate cores
+#define RENDER_CORE 1
+#define OUTPUT_CORE 0
+
 #define DMX512_MAX 512 // Maximum number of channels on a DMX512 universe.
 
 #define REPORT_TASK_INTERVAL 120 * 1000 // How often to report task status in milliseconds
@@ -0,0 +1,75 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#pragma once
+
+#include "effects/Effect.h"
+
+#define CANVAS_MAX_RUN 64   // Pixels of a row worked on at once
+#define CANVAS_NOISE_STEP 4 // Noise is sampled every this many pixels along a row and interpolated between
+#define CANVAS_NOISE_SHIFT 2
+
+/*
+    Helpers for 2D effects. The span is a run of logical pixels on a canvas
+    target.width pixels wide; the pixel map is the XY map, so the pixel at
+    (x, y) is logical pixel y * width + x wherever it is on the strip.
+
+    forEachRun() cuts the span into runs that stay on one row, so an effect
+    does its per-row work once per run rather than per pixel.
+*/
+
+// Row length to use. With no width, everything up to the end of the span is
+// row 0, so x is the span's place along the strip whatever its origin.
+static inline uint16_t canvasWidth(const EffectTarget &target)
+{
+    return target.width ? target.width : target.origin + target.count;
+}
+
+/**
+ * Calls fn(first, x, y, run) for each part of the span that lies on one row,
+ * at most CANVAS_MAX_RUN pixels long. first is the offset into the span.
+ */
+template <typename Fn>
+static inline void forEachRun(const EffectTarget &target, Fn fn)
+{
+    uint16_t width = canvasWidth(target);
+    uint16_t i = 0;
+    while (i < target.count)
+    {
+        uint32_t logical = (uint32_t)target.origin + i;
+        uint16_t y = logical / width;
+        uint16_t x = logical % width;
+        uint16_t run = min(min(width - x, target.count - i), CANVAS_MAX_RUN);
+        fn(i, x, y, run);
+        i += run;
+    }
+}
+
+/**
+ * Fills out with 8-bit noise for one run of a row, in 16.16 noise space.
+ * inoise16() is only called every CANVAS_NOISE_STEP pixels; the pixels in
+ * between are interpolated in fixed point, with x advancing by one add per
+ * sample.
+ *
+ * @param x Noise x of the first pixel.
+ * @param dx Noise units per pixel.
+ */
+static inline void noiseRun(uint8_t *out, uint16_t run, uint32_t x, uint32_t dx, uint32_t y, uint32_t z)
+{
+    uint32_t step = dx << CANVAS_NOISE_SHIFT;
+    int16_t left = inoise16(x, y, z) >> 8;
+    for (uint16_t i = 0; i < run; i += CANVAS_NOISE_STEP)
+    {
+        x += step;
+        int16_t right = inoise16(x, y, z) >> 8;
+        int16_t slope = right - left;
+        uint16_t end = min((uint16_t)(i + CANVAS_NOISE_STEP), run);
+        for (uint16_t j = i; j < end; j++)
+        {
+            out[j] = left + ((slope * (int16_t)(j - i)) >> CANVAS_NOISE_SHIFT);
+        }
+        left = right;
+    }
+}
+
+#endif
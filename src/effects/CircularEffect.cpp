@@ -0,0 +1,87 @@
+#include "effects/Effect.h"
+
+/*
+    Circular mode: the span is treated as a ring and the pattern is a function
+    of each pixel's angle around it, repeated arms times and rotated by phase.
+
+    Everything is fixed point. Angles are 32-bit fractions of a turn, stepped
+    per pixel with one add, so there's a single divide per span. The palette
+    offset for each of the 256 angles only depends on sin and reverse, so it's
+    precomputed and only rebuilt when those change.
+*/
+struct CircularParams
+{
+    uint8_t colorIndex;
+    uint8_t sin;
+    bool reverse;
+    uint8_t arms;
+    uint32_t phase;
+};
+
+template <bool UseWave>
+static void circularKernel(const EffectTarget &target, uint8_t colorIndex, uint32_t angle, uint32_t step, const uint8_t *wave)
+{
+    const PaletteLut &lut = *target.lut;
+    for (uint16_t i = 0; i < target.count; i++, angle += step)
+    {
+        uint16_t mappedIndex = target.table[i];
+
+        // Without a sine the whole ring is one color
+        target.leds[mappedIndex] = UseWave ? lut[colorIndex + wave[angle >> 24]] : lut[colorIndex];
+    }
+}
+
+class CircularEffect : public TypedEffect<CircularParams>
+{
+private:
+    uint8_t wave[256]; // Palette offset for each angle
+    uint8_t waveSin = 0;
+    bool waveReverse = false;
+
+    void buildWave(uint8_t sin, bool reverse)
+    {
+        for (uint16_t a = 0; a < 256; a++)
+        {
+            // Reverse uses the cosine, a quarter turn out from the sine
+            wave[a] = (sin8(reverse ? a + 64 : a) * sin) / 16;
+        }
+        waveSin = sin;
+        waveReverse = reverse;
+    }
+
+protected:
+    void configure(const EffectSettings &settings, CircularParams &params) override
+    {
+        params.colorIndex = settings.colorIndex;
+        params.sin = settings.sin;
+        params.reverse = settings.reverse;
+        params.arms = max(settings.arms, (uint8_t)1);
+        params.phase = settings.phase;
+    }
+
+    void renderParams(const EffectTarget &target, const CircularParams &params) override
+    {
+        if (target.count == 0)
+        {
+            return;
+        }
+
+        if (params.sin == 0)
+        {
+            circularKernel<false>(target, params.colorIndex, 0, 0, NULL);
+            return;
+        }
+
+        if (waveSin != params.sin || waveReverse != params.reverse)
+        {
+            buildWave(params.sin, params.reverse);
+        }
+        uint32_t step = (uint32_t)(((uint64_t)params.arms << 32) / target.count);
+        circularKernel<true>(target, params.colorIndex, params.phase, step, wave);
+    }
+
+public:
+    const char *getName(void) const override { return "circular"; }
+};
+
+REGISTER_EFFECT(CircularEffect)
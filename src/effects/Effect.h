@@ -0,0 +1,112 @@
+#ifndef EFFECT_H
+#define EFFECT_H
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "PaletteLut.h"
+
+#define MAX_EFFECTS 16
+
+/*
+    Where an effect renders: a run of logical pixels in the frame. The
+    pointers are already offset to the first pixel of the run.
+*/
+struct EffectTarget
+{
+    CRGB *leds;                 // The whole frame, indexed by physical pixel
+    const uint16_t *table;      // count entries of the pixel map
+    uint8_t *heat;              // count cells of per-pixel effect state
+    uint16_t count;
+    const PaletteLut *lut;
+    uint16_t width;  // 2D effects: canvas row length in logical pixels
+    uint16_t origin; // 2D effects: logical index of the first pixel, for its place on the canvas
+};
+
+/*
+    Everything an effect can take its parameters from, filled in from the
+    main configuration or a segment. Each effect picks what it needs into its
+    own parameter block once per span, see TypedEffect.
+*/
+struct EffectSettings
+{
+    uint8_t colorIndex;
+    uint8_t sin;
+    bool reverse;
+    uint8_t arms;   // Circular mode
+    uint32_t phase; // Circular mode, a full turn is 2^32
+    uint8_t cooling;  // Fire
+    uint8_t sparking; // Fire
+    uint8_t columns;  // Fire, independent flames the span is split into
+    uint32_t frame;   // Frames rendered so far, the clock for time based effects
+    const char *text; // Text effect
+    uint16_t extent;   // Logical pixels on the whole strip, for effects with state that moves along it
+    uint8_t particles; // Particle effects, the most alive at once
+};
+
+/*
+    An effect. Instances register themselves with REGISTER_EFFECT() and are
+    looked up by name, so adding one doesn't touch LightUtils.
+
+    Effects may keep state between frames, so the registered instance
+    belongs to the render task. Anything else that wants to render one, eg:
+    the benchmark, makes its own with EffectRegistry::create().
+*/
+class Effect
+{
+public:
+    virtual ~Effect() {}
+
+    virtual const char *getName(void) const = 0;
+
+    // Particles alive, for effects that keep them between frames
+    virtual uint16_t getParticleCount(void) const { return 0; }
+
+    // Render from the target palette at full brightness rather than the
+    // blended palette at the configured brightness
+    virtual bool usesTargetPalette(void) const { return false; }
+
+    virtual void render(const EffectTarget &target, const EffectSettings &settings) = 0;
+};
+
+/*
+    An effect with a typed parameter block. configure() fills Params from the
+    settings, then renderParams() renders with them.
+*/
+template <typename Params>
+class TypedEffect : public Effect
+{
+protected:
+    virtual void configure(const EffectSettings &settings, Params &params) = 0;
+    virtual void renderParams(const EffectTarget &target, const Params &params) = 0;
+
+public:
+    void render(const EffectTarget &target, const EffectSettings &settings) override
+    {
+        Params params;
+        configure(settings, params);
+        renderParams(target, params);
+    }
+};
+
+typedef Effect *(*EffectFactory)(void);
+
+class EffectRegistry
+{
+public:
+    static bool add(Effect *effect, EffectFactory factory);
+    static Effect *find(const char *name);   // The render task's instance, NULL if there's no such effect
+    static Effect *create(const char *name); // A new instance for the caller to delete, NULL if there's no such effect
+    static uint8_t count(void);
+    static Effect *get(uint8_t index);
+};
+
+// Registers a single static instance of an effect class at startup, and a
+// factory for more
+#define REGISTER_EFFECT(EffectClass)                                       \
+    static EffectClass EffectClass##Instance;                              \
+    static Effect *EffectClass##Create(void) { return new EffectClass(); } \
+    static const bool EffectClass##Registered = EffectRegistry::add(&EffectClass##Instance, &EffectClass##Create);
+
+#endif
@@ -0,0 +1,66 @@
+#include "effects/Effect.h"
+
+// Function statics, so registering from other files' static initializers
+// doesn't depend on initialization order
+static Effect **effectTable(void)
+{
+    static Effect *effects[MAX_EFFECTS];
+    return effects;
+}
+
+static EffectFactory *factoryTable(void)
+{
+    static EffectFactory factories[MAX_EFFECTS];
+    return factories;
+}
+
+static uint8_t &effectCount(void)
+{
+    static uint8_t count = 0;
+    return count;
+}
+
+bool EffectRegistry::add(Effect *effect, EffectFactory factory)
+{
+    if (effectCount() == MAX_EFFECTS)
+    {
+        return false;
+    }
+    factoryTable()[effectCount()] = factory;
+    effectTable()[effectCount()++] = effect;
+    return true;
+}
+
+Effect *EffectRegistry::find(const char *name)
+{
+    for (uint8_t i = 0; i < effectCount(); i++)
+    {
+        if (strcmp(effectTable()[i]->getName(), name) == 0)
+        {
+            return effectTable()[i];
+        }
+    }
+    return NULL;
+}
+
+Effect *EffectRegistry::create(const char *name)
+{
+    for (uint8_t i = 0; i < effectCount(); i++)
+    {
+        if (strcmp(effectTable()[i]->getName(), name) == 0)
+        {
+            return factoryTable()[i]();
+        }
+    }
+    return NULL;
+}
+
+uint8_t EffectRegistry::count(void)
+{
+    return effectCount();
+}
+
+Effect *EffectRegistry::get(uint8_t index)
+{
+    return index < effectCount() ? effectTable()[index] : NULL;
+}
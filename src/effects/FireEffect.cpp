@@ -0,0 +1,165 @@
+#include "effects/Effect.h"
+
+/*
+    Fire2012: a one-dimensional heat simulation, one cell per pixel, mapped
+    through the palette.
+
+    A span burns as one or more independent columns, each on its own slice of
+    the heat map with the flame rising from the column's start. Cooling and
+    diffusion work on four cells per 32-bit word: the random cooling amounts
+    are scaled and subtracted with saturating byte-lane arithmetic, and the
+    diffusion of each word only reads cells below it that haven't been
+    written yet, so the column is updated in place from the top down.
+*/
+struct FireParams
+{
+    uint8_t cooling;
+    uint8_t sparking;
+    uint8_t columns;
+    bool reverse;
+};
+
+#define LANES_H 0x80808080u
+#define LANES_EVEN 0x00FF00FFu
+
+static inline uint32_t loadCells(const uint8_t *cells)
+{
+    uint32_t word;
+    memcpy(&word, cells, 4); // Columns start on any byte
+    return word;
+}
+
+static inline void storeCells(uint8_t *cells, uint32_t word)
+{
+    memcpy(cells, &word, 4);
+}
+
+// qsub8() on each byte
+static inline uint32_t qsub8x4(uint32_t a, uint32_t b)
+{
+    uint32_t diff = ((a | LANES_H) - (b & ~LANES_H)) ^ ((a ^ ~b) & LANES_H);
+    uint32_t borrow = ((~a & b) | (~(a ^ b) & diff)) & LANES_H;
+    return diff & ~((borrow >> 7) * 0xFF);
+}
+
+// scale8() on each byte, in two 16-bit lanes at a time
+static inline uint32_t scale8x4(uint32_t a, uint8_t scale)
+{
+    uint32_t even = (((a & LANES_EVEN) * scale) >> 8) & LANES_EVEN;
+    uint32_t odd = (((a >> 8) & LANES_EVEN) * scale) & ~LANES_EVEN;
+    return even | odd;
+}
+
+// (below1 + 2 * below2) / 3 on each byte. Multiplying by 85/256 keeps the
+// lanes inside 16 bits; it's at most one below the exact divide.
+static inline uint32_t diffuse8x4(uint32_t below1, uint32_t below2)
+{
+    uint32_t even = ((((below1 & LANES_EVEN) + ((below2 & LANES_EVEN) << 1)) * 85) >> 8) & LANES_EVEN;
+    uint32_t odd = ((((below1 >> 8) & LANES_EVEN) + (((below2 >> 8) & LANES_EVEN) << 1)) * 85) & ~LANES_EVEN;
+    return even | odd;
+}
+
+static inline uint32_t random32(void)
+{
+    return ((uint32_t)random16() << 16) | random16();
+}
+
+/**
+ * Advances one column of the simulation by a frame.
+ */
+static void burnColumn(uint8_t *heat, uint16_t count, uint8_t cooling, uint8_t sparking)
+{
+    // Step 1.  Cool down every cell a little
+    uint8_t limit = min((cooling * 10) / count + 2, 255);
+    uint16_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        storeCells(heat + i, qsub8x4(loadCells(heat + i), scale8x4(random32(), limit)));
+    }
+    for (; i < count; i++)
+    {
+        heat[i] = qsub8(heat[i], random8(limit));
+    }
+
+    // Step 2.  Heat from each cell drifts 'up' and diffuses a little
+    int k = count - 1;
+    for (; k >= 5; k -= 4)
+    {
+        storeCells(heat + k - 3, diffuse8x4(loadCells(heat + k - 4), loadCells(heat + k - 5)));
+    }
+    for (; k >= 2; k--)
+    {
+        heat[k] = (heat[k - 1] + heat[k - 2] + heat[k - 2]) / 3;
+    }
+
+    // Step 3.  Randomly ignite new 'sparks' of heat near the bottom
+    if (random8() < sparking)
+    {
+        uint8_t y = random8(min(count, (uint16_t)7));
+        heat[y] = qadd8(heat[y], random8(160, 255));
+    }
+}
+
+template <bool Reverse>
+static void fireKernel(const EffectTarget &target, const FireParams &params)
+{
+    const PaletteLut &lut = *target.lut;
+    uint16_t columns = constrain((uint16_t)params.columns, (uint16_t)1, target.count);
+
+    for (uint16_t c = 0; c < columns; c++)
+    {
+        uint16_t first = ((uint32_t)target.count * c) / columns;
+        uint16_t count = ((uint32_t)target.count * (c + 1)) / columns - first;
+        uint8_t *heat = target.heat + first;
+        const uint16_t *table = target.table + first;
+
+        burnColumn(heat, count, params.cooling, params.sparking);
+
+        // Step 4.  Map from heat cells to LED colors
+        for (uint16_t j = 0; j < count; j++)
+        {
+            uint16_t mappedIndex = table[Reverse ? (count - 1) - j : j];
+
+            // Scale the heat value from 0-255 down to 0-240
+            // for best results with color palettes.
+            target.leds[mappedIndex] = lut[scale8(heat[j], 240)];
+        }
+    }
+}
+
+class FireEffect : public TypedEffect<FireParams>
+{
+protected:
+    void configure(const EffectSettings &settings, FireParams &params) override
+    {
+        params.cooling = settings.cooling;
+        params.sparking = settings.sparking;
+        params.columns = settings.columns;
+        params.reverse = settings.reverse;
+    }
+
+    void renderParams(const EffectTarget &target, const FireParams &params) override
+    {
+        if (target.count == 0)
+        {
+            return;
+        }
+
+        if (params.reverse)
+        {
+            fireKernel<true>(target, params);
+        }
+        else
+        {
+            fireKernel<false>(target, params);
+        }
+    }
+
+public:
+    const char *getName(void) const override { return "fire"; }
+
+    // Fire maps heat straight through the palette, unblended and unscaled
+    bool usesTargetPalette(void) const override { return true; }
+};
+
+REGISTER_EFFECT(FireEffect)
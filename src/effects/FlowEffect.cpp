@@ -0,0 +1,74 @@
+#include "effects/Canvas.h"
+
+#define FLOW_SCALE 4096           // Noise units per pixel
+#define FLOW_Z_STEP 512           // Noise units per frame
+#define FLOW_SPEED 96             // Drift per frame at full tilt, in noise units
+#define FLOW_VALUE_OFFSET 0x40000 // Brightness is a second field, this far from the color one
+
+/*
+    A flow field: the noise drifts across the canvas in a direction that
+    itself wanders with a slower, one dimensional noise. Color comes from one
+    field and brightness from another, so the patterns stream past each other.
+
+    The drift is the only state. It's advanced once per frame however many
+    spans the effect renders.
+*/
+struct FlowParams
+{
+    uint8_t colorIndex;
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+};
+
+class FlowEffect : public TypedEffect<FlowParams>
+{
+private:
+    uint32_t lastFrame = UINT32_MAX;
+    uint32_t driftX = 0;
+    uint32_t driftY = 0;
+
+protected:
+    void configure(const EffectSettings &settings, FlowParams &params) override
+    {
+        if (settings.frame != lastFrame)
+        {
+            lastFrame = settings.frame;
+            uint8_t heading = inoise8((uint16_t)(settings.frame * 8));
+            driftX += (int32_t)((int16_t)cos8(heading) - 128) * FLOW_SPEED / 128;
+            driftY += (int32_t)((int16_t)sin8(heading) - 128) * FLOW_SPEED / 128;
+        }
+
+        params.colorIndex = settings.colorIndex;
+        params.x = driftX;
+        params.y = driftY;
+        params.z = settings.frame * FLOW_Z_STEP;
+    }
+
+    void renderParams(const EffectTarget &target, const FlowParams &params) override
+    {
+        const PaletteLut &lut = *target.lut;
+        uint8_t hue[CANVAS_MAX_RUN];
+        uint8_t value[CANVAS_MAX_RUN];
+
+        forEachRun(target, [&](uint16_t first, uint16_t x, uint16_t y, uint16_t run)
+        {
+            uint32_t nx = params.x + x * FLOW_SCALE;
+            uint32_t ny = params.y + y * FLOW_SCALE;
+            noiseRun(hue, run, nx, FLOW_SCALE, ny, params.z);
+            noiseRun(value, run, nx + FLOW_VALUE_OFFSET, FLOW_SCALE, ny + FLOW_VALUE_OFFSET, params.z);
+            for (uint16_t j = 0; j < run; j++)
+            {
+                // Noise sits mostly in the middle of its range, stretch it
+                uint8_t v = qsub8(value[j], 64);
+                CRGB color = lut[params.colorIndex + hue[j]];
+                target.leds[target.table[first + j]] = color.nscale8_video(qadd8(v, v));
+            }
+        });
+    }
+
+public:
+    const char *getName(void) const override { return "flow"; }
+};
+
+REGISTER_EFFECT(FlowEffect)
@@ -0,0 +1,56 @@
+#include "effects/Effect.h"
+
+/*
+    The original palette program: the palette scrolls along the span, three
+    steps per pixel, optionally rippled by a sine.
+*/
+struct PaletteFillParams
+{
+    uint8_t colorIndex;
+    uint8_t sin;
+    bool reverse;
+};
+
+/**
+ * Reverse walks the span from its far end.
+ */
+template <bool Reverse, bool UseSin>
+static void fillKernel(const EffectTarget &target, uint8_t colorIndex, uint8_t sin)
+{
+    const PaletteLut &lut = *target.lut;
+    for (uint16_t n = 0; n < target.count; n++)
+    {
+        uint16_t mappedIndex = target.table[Reverse ? target.count - 1 - n : n];
+        target.leds[mappedIndex] = UseSin ? lut[colorIndex + sin8(n * sin)] : lut[colorIndex];
+        colorIndex += 3;
+    }
+}
+
+typedef void (*FillKernel)(const EffectTarget &, uint8_t, uint8_t);
+
+// Indexed by [reverse][sin enabled]
+static const FillKernel fillKernels[2][2] = {
+    {fillKernel<false, false>, fillKernel<false, true>},
+    {fillKernel<true, false>, fillKernel<true, true>},
+};
+
+class PaletteFillEffect : public TypedEffect<PaletteFillParams>
+{
+protected:
+    void configure(const EffectSettings &settings, PaletteFillParams &params) override
+    {
+        params.colorIndex = settings.colorIndex;
+        params.sin = settings.sin;
+        params.reverse = settings.reverse;
+    }
+
+    void renderParams(const EffectTarget &target, const PaletteFillParams &params) override
+    {
+        fillKernels[params.reverse][params.sin != 0](target, params.colorIndex, params.sin);
+    }
+
+public:
+    const char *getName(void) const override { return "palette"; }
+};
+
+REGISTER_EFFECT(PaletteFillEffect)
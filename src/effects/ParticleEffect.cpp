@@ -0,0 +1,317 @@
+#include "effects/Effect.h"
+#include "effects/ParticlePool.h"
+
+#define PARTICLE_FADE_FRAMES 32 // Particles dim over their last this many frames
+
+#define SPARK_SPACING 48          // Logical pixels per new spark each frame
+#define SPARK_MAX_PER_FRAME 8
+#define SPARK_DRIFT 0x1000        // Up to 1/16 pixel per frame either way
+
+#define COMET_CHANCE 8            // Out of 256 each frame
+#define COMET_SPEED_MIN 0x4000    // A quarter of a pixel per frame
+#define COMET_SPEED_MAX 0xFFFF    // ... to a pixel
+#define COMET_TAIL 6
+
+#define FIREWORK_CHANCE 6         // Out of 256 each frame
+#define FIREWORK_GRAVITY 0x0800   // 1/32 pixel per frame per frame, toward the start of the strip
+#define FIREWORK_EMBERS 16
+#define FIREWORK_BURST 3          // Embers leave at up to 1.5 pixels per frame
+
+/*
+    Particle effects: sparks, comets and fireworks moving along the strip.
+
+    Each effect owns a ParticlePool. Particles live in logical pixels over
+    the whole strip, so the simulation steps once per frame however many
+    spans the effect renders, and each span draws only the particles that
+    fall inside it. A span is cleared to black and the particles are added
+    on with saturating adds, so where they cross they brighten rather than
+    cover each other.
+
+    How a particle moves depends only on its kind: gravity is added to its
+    velocity each frame, drag takes velocity >> dragShift off it, and a tail
+    trails the head by that many pixels.
+*/
+struct ParticleKind
+{
+    int32_t gravity;   // Per frame, in particle units
+    uint8_t dragShift; // 0 for none
+    uint8_t tail;
+    bool ages;         // Counts life down, otherwise lives until it leaves the strip
+};
+
+struct ParticleParams
+{
+    bool reverse;
+    uint16_t extent;
+};
+
+/**
+ * Adds a color to one logical pixel if it's in the span.
+ */
+static inline void addPixel(const EffectTarget &target, int32_t logical, const CRGB &color)
+{
+    int32_t local = logical - target.origin;
+    if (local >= 0 && local < target.count)
+    {
+        target.leds[target.table[local]] += color;
+    }
+}
+
+/**
+ * Adds a color at a position between pixels, split between the two it
+ * straddles.
+ */
+static inline void addPoint(const EffectTarget &target, int32_t position, CRGB color)
+{
+    int32_t pixel = position >> 16;
+    uint8_t fraction = (position >> 8) & 0xFF;
+    CRGB right = color;
+    right.nscale8(fraction);
+    color.nscale8(255 - fraction);
+    addPixel(target, pixel, color);
+    addPixel(target, pixel + 1, right);
+}
+
+class ParticleEffect : public TypedEffect<ParticleParams>
+{
+private:
+    const ParticleKind *kinds;
+    uint32_t lastFrame = UINT32_MAX;
+
+    /**
+     * Moves every particle by a frame, retires the ones that are spent or
+     * have left the strip, then lets the effect spawn new ones.
+     */
+    void step(uint16_t extent, uint8_t colorIndex)
+    {
+        const int32_t end = (int32_t)extent * PARTICLE_ONE;
+        uint16_t i = 0;
+        while (i < pool.getCount())
+        {
+            const ParticleKind &kind = kinds[pool.kind[i]];
+            int32_t velocity = pool.velocity[i] + kind.gravity;
+            if (kind.dragShift)
+            {
+                velocity -= velocity >> kind.dragShift;
+            }
+            int32_t position = pool.position[i] + velocity;
+
+            if (position < 0 || position >= end)
+            {
+                pool.retire(i);
+                continue;
+            }
+            if (kind.ages && --pool.life[i] == 0)
+            {
+                uint8_t spentKind = pool.kind[i];
+                uint8_t color = pool.color[i];
+                pool.retire(i);
+                expired(spentKind, position, color);
+                continue;
+            }
+
+            pool.velocity[i] = velocity;
+            pool.position[i] = position;
+            i++;
+        }
+
+        emit(extent, colorIndex);
+    }
+
+protected:
+    ParticlePool pool;
+
+    ParticleEffect(const ParticleKind *kinds) : kinds(kinds) {}
+
+public:
+    uint16_t getParticleCount(void) const override { return pool.getCount(); }
+
+protected:
+
+    virtual void emit(uint16_t extent, uint8_t colorIndex) = 0;                // Spawn this frame's new particles
+    virtual void expired(uint8_t kind, int32_t position, uint8_t color) {}    // A particle's life ran out
+
+    void configure(const EffectSettings &settings, ParticleParams &params) override
+    {
+        if (settings.frame != lastFrame)
+        {
+            lastFrame = settings.frame;
+            pool.setCap(settings.particles);
+            step(settings.extent, settings.colorIndex);
+        }
+
+        params.reverse = settings.reverse;
+        params.extent = settings.extent;
+    }
+
+    void renderParams(const EffectTarget &target, const ParticleParams &params) override
+    {
+        for (uint16_t j = 0; j < target.count; j++)
+        {
+            target.leds[target.table[j]] = CRGB::Black;
+        }
+
+        const PaletteLut &lut = *target.lut;
+        const int32_t first = target.origin;
+        const int32_t last = first + target.count - 1;
+        const int32_t mirror = ((int32_t)params.extent - 1) * PARTICLE_ONE;
+
+        for (uint16_t i = 0; i < pool.getCount(); i++)
+        {
+            const ParticleKind &kind = kinds[pool.kind[i]];
+            int32_t position = params.reverse ? mirror - pool.position[i] : pool.position[i];
+            int32_t pixel = position >> 16;
+            if (pixel + 1 + kind.tail < first || pixel - kind.tail > last)
+            {
+                continue;
+            }
+
+            CRGB color = lut[pool.color[i]];
+            if (kind.ages && pool.life[i] < PARTICLE_FADE_FRAMES)
+            {
+                color.nscale8(pool.life[i] * (256 / PARTICLE_FADE_FRAMES));
+            }
+            addPoint(target, position, color);
+
+            // The tail fades out behind the direction of travel
+            bool forward = (pool.velocity[i] >= 0) != params.reverse;
+            for (uint8_t t = 1; t <= kind.tail; t++)
+            {
+                CRGB faded = color;
+                faded.nscale8(255 - t * 255 / (kind.tail + 1));
+                addPoint(target, position + (forward ? -t : t) * PARTICLE_ONE, faded);
+            }
+        }
+    }
+};
+
+static const ParticleKind sparkKinds[] = {{0, 0, 0, true}};
+
+class SparkEffect : public ParticleEffect
+{
+protected:
+    void emit(uint16_t extent, uint8_t colorIndex) override
+    {
+        uint8_t sparks = min(extent / SPARK_SPACING + 1, SPARK_MAX_PER_FRAME);
+        for (uint8_t s = 0; s < sparks && extent; s++)
+        {
+            int16_t i = pool.spawn();
+            if (i < 0)
+            {
+                break;
+            }
+            pool.position[i] = (int32_t)random16(extent) * PARTICLE_ONE + random16();
+            pool.velocity[i] = (int32_t)random16(2 * SPARK_DRIFT) - SPARK_DRIFT;
+            pool.life[i] = random8(16, 48);
+            pool.color[i] = colorIndex + random8(64);
+            pool.kind[i] = 0;
+        }
+    }
+
+public:
+    SparkEffect() : ParticleEffect(sparkKinds) {}
+    const char *getName(void) const override { return "sparks"; }
+};
+
+static const ParticleKind cometKinds[] = {{0, 0, COMET_TAIL, false}};
+
+class CometEffect : public ParticleEffect
+{
+protected:
+    void emit(uint16_t extent, uint8_t colorIndex) override
+    {
+        if (!extent || random8() >= COMET_CHANCE)
+        {
+            return;
+        }
+        int16_t i = pool.spawn();
+        if (i < 0)
+        {
+            return;
+        }
+
+        // From either end, toward the other
+        int32_t speed = random16(COMET_SPEED_MIN, COMET_SPEED_MAX);
+        bool fromEnd = random8() & 1;
+        pool.position[i] = fromEnd ? (int32_t)extent * PARTICLE_ONE - 1 : 0;
+        pool.velocity[i] = fromEnd ? -speed : speed;
+        pool.life[i] = 255;
+        pool.color[i] = colorIndex + random8();
+        pool.kind[i] = 0;
+    }
+
+public:
+    CometEffect() : ParticleEffect(cometKinds) {}
+    const char *getName(void) const override { return "comets"; }
+};
+
+enum FireworkKind : uint8_t
+{
+    Rocket,
+    Ember
+};
+
+static const ParticleKind fireworkKinds[] = {
+    {-FIREWORK_GRAVITY, 0, 2, true}, // Rocket
+    {-FIREWORK_GRAVITY, 4, 0, true}, // Ember
+};
+
+/*
+    Rockets rise from the start of the strip and burst into embers around
+    the top of their climb. Gravity pulls everything back toward the start.
+*/
+class FireworkEffect : public ParticleEffect
+{
+protected:
+    void emit(uint16_t extent, uint8_t colorIndex) override
+    {
+        if (extent < 4 || random8() >= FIREWORK_CHANCE)
+        {
+            return;
+        }
+        int16_t i = pool.spawn();
+        if (i < 0)
+        {
+            return;
+        }
+
+        // Launched fast enough to reach a third to nine tenths of the way
+        // along, and burst when it gets there
+        uint16_t height = random16(extent / 3, extent * 9 / 10);
+        int32_t speed = sqrtf(2.0f * FIREWORK_GRAVITY * height * PARTICLE_ONE);
+        pool.position[i] = 0;
+        pool.velocity[i] = speed;
+        pool.life[i] = constrain(speed / FIREWORK_GRAVITY, (int32_t)1, (int32_t)255);
+        pool.color[i] = colorIndex + random8();
+        pool.kind[i] = Rocket;
+    }
+
+    void expired(uint8_t kind, int32_t position, uint8_t color) override
+    {
+        if (kind != Rocket)
+        {
+            return;
+        }
+        for (uint8_t e = 0; e < FIREWORK_EMBERS; e++)
+        {
+            int16_t i = pool.spawn();
+            if (i < 0)
+            {
+                break;
+            }
+            pool.position[i] = position;
+            pool.velocity[i] = ((int32_t)random16() - 0x8000) * FIREWORK_BURST;
+            pool.life[i] = random8(24, 64);
+            pool.color[i] = color + random8(32);
+            pool.kind[i] = Ember;
+        }
+    }
+
+public:
+    FireworkEffect() : ParticleEffect(fireworkKinds) {}
+    const char *getName(void) const override { return "fireworks"; }
+};
+
+REGISTER_EFFECT(SparkEffect)
+REGISTER_EFFECT(CometEffect)
+REGISTER_EFFECT(FireworkEffect)
@@ -0,0 +1,44 @@
+#include "effects/ParticlePool.h"
+
+int16_t ParticlePool::spawn(void)
+{
+    if (count >= cap)
+    {
+        return -1;
+    }
+    return count++;
+}
+
+void ParticlePool::retire(uint16_t index)
+{
+    if (index >= count)
+    {
+        return;
+    }
+
+    uint16_t last = --count;
+    if (index != last)
+    {
+        position[index] = position[last];
+        velocity[index] = velocity[last];
+        life[index] = life[last];
+        color[index] = color[last];
+        kind[index] = kind[last];
+    }
+}
+
+/**
+ * Sets how many particles may be alive at once.
+ *
+ * @param newCap 1 to MAX_PARTICLES, clamped.
+ */
+void ParticlePool::setCap(uint16_t newCap)
+{
+    cap = constrain(newCap, (uint16_t)1, (uint16_t)MAX_PARTICLES);
+    count = min(count, cap);
+}
+
+void ParticlePool::clear(void)
+{
+    count = 0;
+}
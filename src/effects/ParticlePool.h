@@ -0,0 +1,42 @@
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#pragma once
+
+#include <Arduino.h>
+
+#define MAX_PARTICLES 128    // Pool capacity, the highest the particle cap goes
+#define PARTICLE_ONE 0x10000 // One logical pixel in particle units, 16.16 fixed point
+
+/*
+    Fixed pool of particles kept as one array per field, so an update loop
+    only streams through the fields it touches.
+
+    Live particles are packed at the front of the arrays: spawn() takes the
+    slot after the last one and retire() moves the last one into the hole,
+    so both are O(1) and nothing is allocated after construction. The cap
+    bounds how many can be alive at once, and with it the per-frame cost of
+    whatever updates and draws them.
+*/
+class ParticlePool
+{
+private:
+    uint16_t count = 0;
+    uint16_t cap = MAX_PARTICLES;
+
+public:
+    int32_t position[MAX_PARTICLES]; // Logical pixels, in particle units
+    int32_t velocity[MAX_PARTICLES]; // Per frame, in particle units
+    uint8_t life[MAX_PARTICLES];     // Frames left
+    uint8_t color[MAX_PARTICLES];    // Palette index
+    uint8_t kind[MAX_PARTICLES];     // Up to the owner
+
+    int16_t spawn(void);          // Index of a new particle, or -1 at the cap. The caller fills in its fields
+    void retire(uint16_t index);  // The last particle moves into index, so visit index again
+    void setCap(uint16_t newCap); // Retires the newest particles above the new cap
+    void clear(void);
+    uint16_t getCount(void) const { return count; }
+    uint16_t getCap(void) const { return cap; }
+};
+
+#endif
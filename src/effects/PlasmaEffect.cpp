@@ -0,0 +1,46 @@
+#include "effects/Canvas.h"
+
+#define PLASMA_SCALE 6144   // Noise units per pixel, 65536 is one noise cell
+#define PLASMA_Z_STEP 1024  // Noise units per frame
+
+/*
+    A noise field drifting through time, mapped through the palette. Sin
+    zooms out: each step adds a sixteenth to the scale.
+*/
+struct PlasmaParams
+{
+    uint8_t colorIndex;
+    uint32_t scale;
+    uint32_t z;
+};
+
+class PlasmaEffect : public TypedEffect<PlasmaParams>
+{
+protected:
+    void configure(const EffectSettings &settings, PlasmaParams &params) override
+    {
+        params.colorIndex = settings.colorIndex;
+        params.scale = PLASMA_SCALE + (PLASMA_SCALE / 16) * settings.sin;
+        params.z = settings.frame * PLASMA_Z_STEP;
+    }
+
+    void renderParams(const EffectTarget &target, const PlasmaParams &params) override
+    {
+        const PaletteLut &lut = *target.lut;
+        uint8_t noise[CANVAS_MAX_RUN];
+
+        forEachRun(target, [&](uint16_t first, uint16_t x, uint16_t y, uint16_t run)
+        {
+            noiseRun(noise, run, x * params.scale, params.scale, y * params.scale, params.z);
+            for (uint16_t j = 0; j < run; j++)
+            {
+                target.leds[target.table[first + j]] = lut[params.colorIndex + noise[j]];
+            }
+        });
+    }
+
+public:
+    const char *getName(void) const override { return "plasma"; }
+};
+
+REGISTER_EFFECT(PlasmaEffect)
@@ -0,0 +1,75 @@
+#include "effects/Canvas.h"
+#include "effects/Font5x7.h"
+
+#define TEXT_FRAMES_PER_COLUMN 3 // Scroll speed
+#define TEXT_COLUMN_STEP 4       // Palette steps from one text column to the next
+
+/*
+    Scrolls the configured text right to left across the canvas, centred
+    vertically, colored along the palette. Each character is FONT_GLYPH_WIDTH
+    columns plus a gap. Pixels off the glyphs are black.
+*/
+struct TextParams
+{
+    uint8_t colorIndex;
+    const char *text;
+    uint32_t scroll; // Columns scrolled so far
+};
+
+class TextEffect : public TypedEffect<TextParams>
+{
+protected:
+    void configure(const EffectSettings &settings, TextParams &params) override
+    {
+        params.colorIndex = settings.colorIndex;
+        params.text = settings.text ? settings.text : "";
+        params.scroll = settings.frame / TEXT_FRAMES_PER_COLUMN;
+    }
+
+    void renderParams(const EffectTarget &target, const TextParams &params) override
+    {
+        if (target.count == 0)
+        {
+            return;
+        }
+
+        const PaletteLut &lut = *target.lut;
+        const uint16_t width = canvasWidth(target);
+        const uint16_t firstRow = target.origin / width;
+        const uint16_t rows = (target.origin + target.count - 1) / width - firstRow + 1;
+        const int16_t top = rows > FONT_GLYPH_HEIGHT ? (rows - FONT_GLYPH_HEIGHT) / 2 : 0;
+
+        const uint8_t pitch = FONT_GLYPH_WIDTH + 1;
+        const uint32_t textWidth = strlen(params.text) * pitch;
+        const uint32_t period = textWidth + width; // Enters from the right, leaves at the left
+
+        forEachRun(target, [&](uint16_t first, uint16_t x, uint16_t y, uint16_t run)
+        {
+            int16_t glyphRow = (int16_t)(y - firstRow) - top;
+            bool onText = textWidth && glyphRow >= 0 && glyphRow < FONT_GLYPH_HEIGHT;
+            uint32_t position = (x + params.scroll) % period;
+
+            for (uint16_t j = 0; j < run; j++, position = position + 1 == period ? 0 : position + 1)
+            {
+                CRGB color = CRGB::Black;
+                int32_t column = (int32_t)position - width;
+                if (onText && column >= 0 && (uint32_t)column < textWidth)
+                {
+                    uint8_t glyph = column % pitch;
+                    uint8_t c = params.text[column / pitch];
+                    if (glyph < FONT_GLYPH_WIDTH && c >= FONT_FIRST_CHAR && c <= FONT_LAST_CHAR &&
+                        (font5x7[c - FONT_FIRST_CHAR][glyph] >> glyphRow) & 1)
+                    {
+                        color = lut[params.colorIndex + column * TEXT_COLUMN_STEP];
+                    }
+                }
+                target.leds[target.table[first + j]] = color;
+            }
+        });
+    }
+
+public:
+    const char *getName(void) const override { return "text"; }
+};
+
+REGISTER_EFFECT(TextEffect)
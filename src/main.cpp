@@ -14,6 +14,8 @@
 #include "NovaIO.h"
 #include "main.h"
 #include "LightUtils.h"
+#include "SceneStore.h"
+#include "ConfigFile.h"
 #include "Web.h"
 #include "utilities/PreferencesManager.h"
 #include "fileSystemHelper.h"
@@ -24,8 +26,6 @@
 
 #define FORMAT_LITTLEFS_IF_FAILED true
 
-#define CONFIG_FILE "/config.json"
-
 void TaskLightUtils(void *pvParameters);
 void TaskModes(void *pvParameters);
 void TaskWeb(void *pvParameters);
@@ -114,15 +114,30 @@ void setup() {
         listDir(LittleFS, "/", 0);
     }
 
+    // LightUtils only needs preferences, so bring it up first and let the
+    // config file override it along with the network and I/O settings.
+    Serial.println("new LightUtils");
+    lightUtils = new LightUtils();
+
+    Serial.println("Loading config file");
+    loadConfigFile(CONFIG_FILE);
+
+    // The strip layout comes from the config file, so the LED buffers can
+    // only be sized now
+    if (!lightUtils->begin(bootConfig.strips))
+    {
+        Serial.println("LightUtils: not enough memory for the LED buffers, the lights stay off");
+    }
+
     Serial.println("Setting up Serial2");
-    Serial2.begin(921600, SERIAL_8N1, UART2_RX, UART2_TX);
+    Serial2.begin(bootConfig.io.serial2Baud, SERIAL_8N1, UART2_RX, UART2_TX);
 
     randomSeed(esp_random()); // Seed the random number generator with more entropy
 
-    Serial.println("Set clock of I2C interface to 0.4mhz");
+    Serial.printf("Set clock of I2C interface to %u hz\n", bootConfig.io.i2cClock);
     Wire.begin();
 
-    Wire.setClock(400000UL); // 400khz
+    Wire.setClock(bootConfig.io.i2cClock);
 
     Serial.println("new NovaIO");
     novaIO = new NovaIO();
@@ -133,15 +148,16 @@ void setup() {
     // Removed StarSequence initialization
     // Removed Ambient initialization
 
-    Serial.println("new LightUtils");
-    lightUtils = new LightUtils();
+    Serial.println("new SceneStore");
+    sceneStore = new SceneStore();
+    sceneStore->begin();
 
     String apName = "IE_" + getLastFourOfMac();
 
     // Set WiFi mode to WIFI_AP_STA for simultaneous AP and STA mode
     WiFi.mode(WIFI_AP_STA);
 
-    WiFi.softAP(apName.c_str(), "dragonsofeden");
+    WiFi.softAP(apName.c_str(), bootConfig.network.apPassword);
     WiFi.setSleep(false); // Disable power saving on the wifi interface.
 
     WiFi.onEvent(WiFiEvent);
@@ -151,6 +167,10 @@ void setup() {
     {
         wifiMulti.addAP(networks[i].ssid, networks[i].password);
     }
+    for (int i = 0; i < bootConfig.network.networkCount; i++)
+    {
+        wifiMulti.addAP(bootConfig.network.networks[i].ssid, bootConfig.network.networks[i].password);
+    }
 
     if (0) // We don't need this at startup. We have a task that will turn it on.
     {
@@ -4,9 +4,19 @@
 Preferences PreferencesManager::prefs;
 bool PreferencesManager::isInit = false;
 
+SemaphoreHandle_t PreferencesManager::journalMutex = NULL;
+PreferencesManager::JournalEntry PreferencesManager::journal[PreferencesManager::JOURNAL_SIZE];
+uint8_t PreferencesManager::journalCount = 0;
+uint32_t PreferencesManager::firstDirtyMs = 0;
+uint32_t PreferencesManager::lastWriteMs = 0;
+PreferencesManager::JournalStats PreferencesManager::stats = {};
+
 void PreferencesManager::init() {
     if (!isInit) {
         prefs.begin(NAMESPACE, false);
+        if (journalMutex == NULL) {
+            journalMutex = xSemaphoreCreateMutex();
+        }
         isInit = true;
     }
 }
@@ -17,6 +27,7 @@ void PreferencesManager::begin() {
 
 void PreferencesManager::end() {
     if (isInit) {
+        flush();
         prefs.end();
         isInit = false;
     }
@@ -24,30 +35,207 @@ void PreferencesManager::end() {
 
 bool PreferencesManager::getBool(const char* key, bool defaultValue) {
     init();
-    return prefs.getBool(key, defaultValue);
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    JournalEntry* entry = findEntry(key);
+    bool value = entry ? entry->data[0] != 0 : prefs.getBool(key, defaultValue);
+    xSemaphoreGive(journalMutex);
+    return value;
 }
 
 String PreferencesManager::getString(const char* key, String defaultValue) {
     init();
-    return prefs.getString(key, defaultValue);
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    JournalEntry* entry = findEntry(key);
+    String value = entry ? String((const char*)entry->data) : prefs.getString(key, defaultValue);
+    xSemaphoreGive(journalMutex);
+    return value;
 }
 
 int PreferencesManager::getInt(const char* key, int defaultValue) {
     init();
-    return prefs.getInt(key, defaultValue);
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    JournalEntry* entry = findEntry(key);
+    int value = defaultValue;
+    if (entry) {
+        int32_t stored;
+        memcpy(&stored, entry->data, sizeof(stored));
+        value = stored;
+    } else {
+        value = prefs.getInt(key, defaultValue);
+    }
+    xSemaphoreGive(journalMutex);
+    return value;
 }
 
-void PreferencesManager::setBool(const char* key, bool value) {
+size_t PreferencesManager::getBytes(const char* key, void* buffer, size_t maxLength) {
     init();
-    prefs.putBool(key, value);
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    JournalEntry* entry = findEntry(key);
+    size_t length = 0;
+    if (entry) {
+        length = min((size_t)entry->length, maxLength);
+        memcpy(buffer, entry->data, length);
+    } else if (prefs.isKey(key)) {
+        length = prefs.getBytes(key, buffer, maxLength);
+    }
+    xSemaphoreGive(journalMutex);
+    return length;
+}
+
+void PreferencesManager::setBool(const char* key, bool value) {
+    uint8_t stored = value ? 1 : 0;
+    journalWrite(key, EntryType::Bool, &stored, sizeof(stored));
 }
 
 void PreferencesManager::setString(const char* key, const String& value) {
-    init();
-    prefs.putString(key, value);
+    // Strings carry their terminator in the journal so getString() can read them in place
+    journalWrite(key, EntryType::String, value.c_str(), value.length() + 1);
 }
 
 void PreferencesManager::setInt(const char* key, int value) {
+    int32_t stored = value;
+    journalWrite(key, EntryType::Int, &stored, sizeof(stored));
+}
+
+void PreferencesManager::setBytes(const char* key, const void* value, size_t length) {
+    journalWrite(key, EntryType::Bytes, value, length);
+}
+
+/**
+ * Commits the journal if it has been quiet for JOURNAL_QUIET_MS, or if the
+ * oldest dirty key has waited JOURNAL_MAX_DELAY_MS.
+ */
+void PreferencesManager::loop() {
+    init();
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    if (journalCount) {
+        uint32_t now = millis();
+        if (now - lastWriteMs >= JOURNAL_QUIET_MS || now - firstDirtyMs >= JOURNAL_MAX_DELAY_MS) {
+            commitLocked();
+        }
+    }
+    xSemaphoreGive(journalMutex);
+}
+
+/**
+ * Commits every pending key to NVS immediately.
+ */
+void PreferencesManager::flush() {
+    init();
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    commitLocked();
+    xSemaphoreGive(journalMutex);
+}
+
+PreferencesManager::JournalStats PreferencesManager::getJournalStats() {
+    init();
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    JournalStats copy = stats;
+    xSemaphoreGive(journalMutex);
+    return copy;
+}
+
+/**
+ * Finds the pending journal entry for a key. Caller must hold journalMutex.
+ */
+PreferencesManager::JournalEntry* PreferencesManager::findEntry(const char* key) {
+    for (uint8_t i = 0; i < journalCount; i++) {
+        if (strcmp(journal[i].key, key) == 0) {
+            return &journal[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Records a value in the journal. A key that's already pending is
+ * overwritten in place, so a burst of writes to the same key costs one
+ * NVS write when the journal is committed.
+ *
+ * Keys longer than MAX_KEY_LENGTH are rejected: cut short they would be
+ * stored under a key no getter asks for.
+ */
+void PreferencesManager::journalWrite(const char* key, EntryType type, const void* data, size_t length) {
+    if (strlen(key) > MAX_KEY_LENGTH) {
+        Serial.printf("Preferences: key '%s' is longer than %u characters, not saved\n", key, (unsigned)MAX_KEY_LENGTH);
+        return;
+    }
+
     init();
-    prefs.putInt(key, value);
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+
+    uint32_t now = millis();
+    stats.writesRequested++;
+
+    JournalEntry* entry = findEntry(key);
+    if (entry) {
+        stats.writesAvoided++;
+    } else {
+        if (journalCount == JOURNAL_SIZE) {
+            // Out of slots. Make room rather than lose a write.
+            commitLocked();
+        }
+        if (journalCount == 0) {
+            firstDirtyMs = now;
+        }
+        entry = &journal[journalCount++];
+        strlcpy(entry->key, key, sizeof(entry->key));
+    }
+
+    if (length > JOURNAL_VALUE_SIZE) {
+        // Too big to park. Drop any pending copy and write it through.
+        *entry = journal[--journalCount];
+        if (type == EntryType::String) {
+            stats.bytesCommitted += prefs.putString(key, (const char*)data);
+        } else {
+            stats.bytesCommitted += prefs.putBytes(key, data, length);
+        }
+        stats.keysCommitted++;
+        xSemaphoreGive(journalMutex);
+        return;
+    }
+
+    entry->type = type;
+    entry->length = length;
+    memcpy(entry->data, data, length);
+    lastWriteMs = now;
+
+    xSemaphoreGive(journalMutex);
+}
+
+/**
+ * Writes every pending entry to NVS and empties the journal. Caller must
+ * hold journalMutex.
+ */
+void PreferencesManager::commitLocked() {
+    if (!journalCount) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < journalCount; i++) {
+        JournalEntry& entry = journal[i];
+        size_t written = 0;
+        switch (entry.type) {
+        case EntryType::Bool:
+            written = prefs.putBool(entry.key, entry.data[0] != 0);
+            break;
+        case EntryType::Int: {
+            int32_t value;
+            memcpy(&value, entry.data, sizeof(value));
+            written = prefs.putInt(entry.key, value);
+            break;
+        }
+        case EntryType::String:
+            written = prefs.putString(entry.key, (const char*)entry.data);
+            break;
+        case EntryType::Bytes:
+            written = prefs.putBytes(entry.key, entry.data, entry.length);
+            break;
+        }
+        stats.bytesCommitted += written;
+        stats.keysCommitted++;
+    }
+
+    stats.commits++;
+    journalCount = 0;
 }
@@ -3,6 +3,7 @@
 
 #include <Preferences.h>
 #include <Arduino.h>
+#include "freertos/semphr.h"
 
 class PreferencesManager {
 public:
@@ -13,20 +14,68 @@ public:
     static bool getBool(const char* key, bool defaultValue = false);
     static String getString(const char* key, String defaultValue = "");
     static int getInt(const char* key, int defaultValue = 0);
+    static size_t getBytes(const char* key, void* buffer, size_t maxLength); // Returns bytes read, 0 if missing
     
     // Setters
+    //   These don't touch NVS. The value is parked in the write-behind journal
+    //   and committed by loop() once the writes go quiet, or by flush().
     static void setBool(const char* key, bool value);
     static void setString(const char* key, const String& value);
     static void setInt(const char* key, int value);
+    static void setBytes(const char* key, const void* value, size_t length);
+
+    // Write-behind journal
+    static void loop();  // Call periodically. Commits the journal when it's due.
+    static void flush(); // Commit everything pending right now (eg: before a restart)
+
+    struct JournalStats {
+        uint32_t writesRequested; // Setter calls
+        uint32_t writesAvoided;   // Setter calls that were folded into a pending entry
+        uint32_t commits;         // Batches written to NVS
+        uint32_t keysCommitted;   // Individual NVS writes
+        uint32_t bytesCommitted;  // Payload bytes written to NVS
+    };
+    static JournalStats getJournalStats();
 
     // Only keep keys needed for the receiver
     static constexpr const char* NAMESPACE = "nova";
     static constexpr const char* KEY_REMOTE_MAC = "remote_mac";
+
+    static constexpr uint32_t JOURNAL_QUIET_MS = 1500;      // Commit once nothing has been written for this long
+    static constexpr uint32_t JOURNAL_MAX_DELAY_MS = 10000; // ... but never hold a dirty key longer than this
+    static constexpr uint8_t JOURNAL_SIZE = 16;             // Distinct dirty keys held before a forced commit
+    static constexpr size_t JOURNAL_VALUE_SIZE = 128;       // Larger values are written through immediately
+    static constexpr size_t MAX_KEY_LENGTH = 15;            // NVS limit, longer keys are rejected by the setters
     
 private:
+    enum class EntryType : uint8_t {
+        Bool,
+        Int,
+        String,
+        Bytes
+    };
+
+    struct JournalEntry {
+        char key[MAX_KEY_LENGTH + 1];
+        EntryType type;
+        uint16_t length;
+        uint8_t data[JOURNAL_VALUE_SIZE];
+    };
+
     static Preferences prefs;
     static bool isInit;
     static void init();
+
+    static SemaphoreHandle_t journalMutex;
+    static JournalEntry journal[JOURNAL_SIZE];
+    static uint8_t journalCount;
+    static uint32_t firstDirtyMs;
+    static uint32_t lastWriteMs;
+    static JournalStats stats;
+
+    static JournalEntry* findEntry(const char* key);
+    static void journalWrite(const char* key, EntryType type, const void* data, size_t length);
+    static void commitLocked();
 };
 
 #endif